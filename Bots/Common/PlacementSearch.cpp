@@ -0,0 +1,111 @@
+#include "PlacementSearch.h"
+
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+namespace {
+    bool fits(const uint8_t* cells, int width, int height, uint16_t mask, int px, int py) {
+        for (int i = 0; i < 16; ++i) {
+            if (!(mask & (1u << i))) {
+                continue;
+            }
+            int x = px + (i % 4);
+            int y = py + (i / 4);
+            if (x < 0 || x >= width || y >= height) {
+                return false;
+            }
+            if (y >= 0 && cells[y * width + x] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Weights from Pierre Dellacherie style evaluation, tuned for a narrow well
+    double evaluate(const std::vector<uint8_t>& cells, int width, int height) {
+        static constexpr double HEIGHT_WEIGHT    = -0.51;
+        static constexpr double LINES_WEIGHT     =  0.76;
+        static constexpr double HOLES_WEIGHT     = -0.36;
+        static constexpr double BUMPINESS_WEIGHT = -0.18;
+
+        int lines = 0;
+        for (int y = 0; y < height; ++y) {
+            bool full = true;
+            for (int x = 0; x < width && full; ++x) {
+                full = cells[y * width + x] != 0;
+            }
+            lines += full;
+        }
+
+        int aggregate_height = 0, holes = 0, bumpiness = 0, previous_height = -1;
+        for (int x = 0; x < width; ++x) {
+            int column_height = 0;
+            for (int y = 0; y < height; ++y) {
+                if (cells[y * width + x] != 0) {
+                    if (column_height == 0) {
+                        column_height = height - y;
+                    }
+                } else if (column_height != 0) {
+                    ++holes;
+                }
+            }
+            aggregate_height += column_height;
+            if (previous_height >= 0) {
+                bumpiness += std::abs(column_height - previous_height);
+            }
+            previous_height = column_height;
+        }
+
+        return HEIGHT_WEIGHT * aggregate_height + LINES_WEIGHT * lines +
+               HOLES_WEIGHT * holes + BUMPINESS_WEIGHT * bumpiness;
+    }
+}
+
+PlacementSearch::Placement PlacementSearch::find_best(const uint8_t* cells, int width, int height, const Piece& piece) {
+    Placement best = {false, 0, 0};
+    double best_score = -std::numeric_limits<double>::infinity();
+
+    std::vector<uint8_t> scratch(cells, cells + width * height);
+    for (int rotations = 0; rotations < 4; ++rotations) {
+        uint16_t mask = piece.rotation_masks[(piece.rotation + rotations) % 4];
+        if (!fits(cells, width, height, mask, piece.x, piece.y)) {
+            continue;
+        }
+
+        // Walk each way from the spawn column until something is hit
+        for (int direction = -1; direction <= 1; direction += 2) {
+            for (int shift = (direction < 0 ? 0 : 1); ; shift += direction) {
+                int x = piece.x + shift;
+                if (!fits(cells, width, height, mask, x, piece.y)) {
+                    break;
+                }
+
+                int y = piece.y;
+                while (fits(cells, width, height, mask, x, y + 1)) {
+                    ++y;
+                }
+
+                // Place, score, then take the tetromino back out again
+                for (int i = 0; i < 16; ++i) {
+                    if ((mask & (1u << i)) && y + i / 4 >= 0) {
+                        scratch[(y + i / 4) * width + x + i % 4] = 1;
+                    }
+                }
+                double score = evaluate(scratch, width, height);
+                for (int i = 0; i < 16; ++i) {
+                    if ((mask & (1u << i)) && y + i / 4 >= 0) {
+                        scratch[(y + i / 4) * width + x + i % 4] = 0;
+                    }
+                }
+
+                if (score > best_score) {
+                    best_score = score;
+                    best = {true, rotations, shift};
+                }
+            }
+        }
+    }
+
+    return best;
+}
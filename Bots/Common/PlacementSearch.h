@@ -0,0 +1,27 @@
+// Shared move search used by the bundled bots
+// Tries every rotation and column for the active tetromino and scores the resulting stack
+
+#ifndef INC_3D_TETRIS_PLACEMENTSEARCH_H
+#define INC_3D_TETRIS_PLACEMENTSEARCH_H
+
+#include <cstdint>
+
+namespace PlacementSearch {
+    struct Piece {
+        uint16_t rotation_masks[4]; // 4x4 block masks, bit (y * 4 + x)
+        int rotation;               // Current rotation state
+        int x;                      // Top left point of the 4x4 space
+        int y;
+    };
+
+    struct Placement {
+        bool valid;
+        int rotations; // Number of right rotations to apply first
+        int shift;     // Columns to move afterwards, negative is left
+    };
+
+    // Cells are row major with zero meaning empty
+    Placement find_best(const uint8_t* cells, int width, int height, const Piece& piece);
+}
+
+#endif //INC_3D_TETRIS_PLACEMENTSEARCH_H
@@ -0,0 +1,35 @@
+// Example in-process bot plugin
+// Usage: ./3d-tetris --bot-plugin ./libexample-bot.so
+
+#include "BotPlugin.h"
+#include "PlacementSearch.h"
+
+extern "C" int tetris_bot_init(uint32_t abi_version) {
+    return abi_version == TETRIS_BOT_ABI_VERSION ? 0 : -1;
+}
+
+extern "C" int tetris_bot_suggest_move(const tetris_board_view* board,
+                                       const uint8_t* queue, uint32_t queue_length,
+                                       tetris_bot_move* move) {
+    PlacementSearch::Piece piece;
+    for (int r = 0; r < 4; ++r) {
+        piece.rotation_masks[r] = board->rotation_masks[r];
+    }
+    piece.rotation = board->current_rotation;
+    piece.x = board->current_x;
+    piece.y = board->current_y;
+
+    PlacementSearch::Placement placement =
+            PlacementSearch::find_best(board->cells, board->width, board->height, piece);
+    if (!placement.valid) {
+        return -1;
+    }
+
+    move->rotations = static_cast<uint8_t>(placement.rotations);
+    move->shift     = static_cast<int8_t>(placement.shift);
+    move->hard_drop = 1;
+    return 0;
+}
+
+extern "C" void tetris_bot_shutdown(void) {
+}
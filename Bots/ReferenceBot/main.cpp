@@ -0,0 +1,99 @@
+// Reference bot for the shared memory bot bridge
+// Usage: reference-bot <shm name>, after starting the game with --bot-shm <shm name>
+
+#include "BotProtocol.h"
+#include "PlacementSearch.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+static BotProtocol::SharedRegion* attach(const char* name) {
+    // Wait for the game to create the region
+    int fd;
+    while ((fd = shm_open(name, O_RDWR, 0)) == -1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    void* mapping = mmap(nullptr, sizeof(BotProtocol::SharedRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    auto region = static_cast<BotProtocol::SharedRegion*>(mapping);
+    while (region->magic.load(std::memory_order_acquire) != BotProtocol::MAGIC) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (region->version != BotProtocol::VERSION) {
+        std::fprintf(stderr, "reference-bot: protocol version %u does not match %u\n",
+                     region->version, BotProtocol::VERSION);
+        return nullptr;
+    }
+    return region;
+}
+
+static void send(BotProtocol::SharedRegion* region, uint32_t sequence, BotProtocol::Command command) {
+    BotProtocol::CommandMessage message = {sequence, static_cast<uint8_t>(command)};
+    while (!region->commands.push(message)) {
+        std::this_thread::yield();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <shm name>\n", argv[0]);
+        return 1;
+    }
+
+    BotProtocol::SharedRegion* region = attach(argv[1]);
+    if (region == nullptr) {
+        std::fprintf(stderr, "reference-bot: failed to attach to %s\n", argv[1]);
+        return 1;
+    }
+
+    uint32_t last_sequence = 0;
+    while (region->magic.load(std::memory_order_acquire) == BotProtocol::MAGIC) {
+        // Only the newest snapshot matters, older ones are skipped
+        const BotProtocol::Snapshot* snapshot = region->snapshots.latest();
+        if (snapshot == nullptr || snapshot->sequence == last_sequence) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            continue;
+        }
+        last_sequence = snapshot->sequence;
+
+        if (snapshot->game_over) {
+            continue;
+        }
+
+        // Read the snapshot in place
+        PlacementSearch::Piece piece;
+        for (int r = 0; r < 4; ++r) {
+            piece.rotation_masks[r] = snapshot->rotation_masks[r];
+        }
+        piece.rotation = snapshot->current_rotation;
+        piece.x = snapshot->current_x;
+        piece.y = snapshot->current_y;
+
+        PlacementSearch::Placement placement =
+                PlacementSearch::find_best(snapshot->cells, GAME_WIDTH, GAME_HEIGHT, piece);
+        if (!placement.valid) {
+            continue;
+        }
+
+        for (int r = 0; r < placement.rotations; ++r) {
+            send(region, last_sequence, BotProtocol::ROTATE);
+        }
+        for (int s = 0; s < (placement.shift < 0 ? -placement.shift : placement.shift); ++s) {
+            send(region, last_sequence, placement.shift < 0 ? BotProtocol::LEFT : BotProtocol::RIGHT);
+        }
+        send(region, last_sequence, BotProtocol::HARD_DROP);
+    }
+
+    munmap(region, sizeof(BotProtocol::SharedRegion));
+    return 0;
+}
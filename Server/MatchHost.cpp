@@ -0,0 +1,71 @@
+#include "MatchHost.h"
+
+#include <algorithm>
+#include <numeric>
+
+MatchHost::MatchHost(uint32_t max_matches, unsigned int num_workers)
+        : slab(max_matches), pool(num_workers), report_start(Clock::now())
+{
+    for (unsigned int i = 0; i < pool.get_num_workers(); ++i) {
+        engines.emplace_back(new Simulation());
+    }
+    step_job = [this](unsigned int worker, uint32_t begin, uint32_t end) { step_batch(worker, begin, end); };
+}
+
+void MatchHost::tick() {
+    Clock::time_point start = Clock::now();
+
+    pool.run(slab.get_end(), MatchHostUtil::BATCH_SIZE, step_job);
+    game_ticks += slab.get_num_active();
+    ++current_tick;
+
+    tick_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+}
+
+void MatchHost::step_batch(unsigned int worker, uint32_t begin, uint32_t end) {
+    Simulation& engine = *engines[worker];
+    SimulationUtil::Input inputs[MatchSlabUtil::MAX_TICK_INPUTS];
+
+    for (uint32_t i = begin; i < end; ++i) {
+        MatchSlabUtil::Match& match = slab[i];
+        if (!match.active || match.state.game_over) {
+            match.num_inputs = 0;
+            continue;
+        }
+
+        engine.load_state(match.state);
+        for (uint8_t j = 0; j < match.num_inputs; ++j) {
+            inputs[j] = static_cast<SimulationUtil::Input>(match.inputs[j]);
+        }
+        engine.tick(inputs, match.num_inputs);
+        match.num_inputs = 0;
+
+        match.events |= engine.consume_events();
+        match.state = engine.save_state();
+    }
+}
+
+MatchHostUtil::TickReport MatchHost::take_report() {
+    MatchHostUtil::TickReport report;
+    report.num_ticks = static_cast<uint32_t>(tick_ms.size());
+    report.num_game_ticks = game_ticks;
+
+    Clock::time_point now = Clock::now();
+    double seconds = std::chrono::duration<double>(now - report_start).count();
+    report.game_ticks_per_second = seconds > 0.0 ? game_ticks / seconds : 0.0;
+
+    if (tick_ms.empty()) {
+        report.mean_tick_ms = report.p99_tick_ms = report.max_tick_ms = 0.0;
+    } else {
+        report.mean_tick_ms = std::accumulate(tick_ms.begin(), tick_ms.end(), 0.0) / tick_ms.size();
+        size_t p99 = std::min(tick_ms.size() - 1, tick_ms.size() * 99 / 100);
+        std::nth_element(tick_ms.begin(), tick_ms.begin() + p99, tick_ms.end());
+        report.p99_tick_ms = tick_ms[p99];
+        report.max_tick_ms = *std::max_element(tick_ms.begin(), tick_ms.end());
+    }
+
+    tick_ms.clear();
+    game_ticks = 0;
+    report_start = now;
+    return report;
+}
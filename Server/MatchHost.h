@@ -0,0 +1,61 @@
+#ifndef INC_3D_TETRIS_MATCHHOST_H
+#define INC_3D_TETRIS_MATCHHOST_H
+
+#include "MatchSlab.h"
+#include "WorkerPool.h"
+#include "Util/NonCopyable.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace MatchHostUtil {
+    static constexpr uint32_t BATCH_SIZE = 256; // Games stepped by a worker before it takes another batch
+
+    // How ticking has gone since the last report
+    struct TickReport {
+        uint32_t num_ticks;
+        uint64_t num_game_ticks;  // Summed over every game
+        double game_ticks_per_second;
+        double mean_tick_ms;
+        double p99_tick_ms;
+        double max_tick_ms;
+    };
+}
+
+// Steps every game in a MatchSlab on a pool of worker threads
+// Each worker loads a game into its own Simulation, ticks it, and writes it back
+class MatchHost : public Util::NonCopyable {
+public:
+    MatchHost(uint32_t max_matches, unsigned int num_workers);
+
+    // Steps every active game once
+    void tick();
+
+    MatchHostUtil::TickReport take_report(); // Also starts the next report
+
+    // Getters
+    MatchSlab& get_slab() { return slab; }
+    const MatchSlab& get_slab() const { return slab; }
+    uint32_t get_current_tick() const { return current_tick; }
+    unsigned int get_num_workers() const { return pool.get_num_workers(); }
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void step_batch(unsigned int worker, uint32_t begin, uint32_t end);
+
+    MatchSlab slab;
+    WorkerPool pool;
+    std::vector<std::unique_ptr<Simulation>> engines; // One per worker
+    WorkerPool::Job step_job;
+
+    uint32_t current_tick = 0;
+
+    std::vector<double> tick_ms; // Since the last report
+    uint64_t game_ticks = 0;
+    Clock::time_point report_start;
+};
+
+
+#endif //INC_3D_TETRIS_MATCHHOST_H
@@ -0,0 +1,48 @@
+#ifndef INC_3D_TETRIS_MATCHPROTOCOL_H
+#define INC_3D_TETRIS_MATCHPROTOCOL_H
+
+#include <cstdint>
+
+/*
+ * Match server protocol
+ * ---------------------
+ * Clients talk to the server over TCP. Every message is a fixed size, so a stream is read by
+ * chopping it into messages without any lengths.
+ *
+ * Each connection plays one game on the server. The server sends SERVER_WELCOME when the game
+ * starts, then a SERVER_UPDATE after every tick in which something happened to the game.
+ * Inputs are applied on the next tick the server runs, which is the only clock the game has.
+ */
+namespace MatchProtocol {
+    static constexpr uint16_t DEFAULT_PORT = 40100;
+
+    enum ClientMessageType : uint8_t {
+        CLIENT_INPUT = 1, // input is a SimulationUtil::Input
+        CLIENT_RESET = 2, // Start a new game
+    };
+
+    struct ClientMessage {
+        uint8_t type;
+        uint8_t input;
+    };
+    static_assert(sizeof(ClientMessage) == 2, "Client messages must not be padded");
+
+    enum ServerMessageType : uint8_t {
+        SERVER_WELCOME = 1,
+        SERVER_UPDATE  = 2,
+    };
+
+    struct ServerMessage {
+        uint8_t  type;
+        uint8_t  game_over;
+        uint16_t padding;
+        uint32_t tick;   // Server tick the message was sent after
+        uint32_t seed;
+        uint32_t events; // SimulationUtil::Event flags since the last update
+        uint32_t score;
+        uint32_t lines_cleared;
+    };
+    static_assert(sizeof(ServerMessage) == 24, "Server messages must not be padded");
+}
+
+#endif //INC_3D_TETRIS_MATCHPROTOCOL_H
@@ -0,0 +1,369 @@
+#include "MatchServer.h"
+#include "Constants.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+MatchServer::MatchServer(uint16_t port, uint32_t max_matches, unsigned int num_workers)
+        : host(max_matches, num_workers), next_seed(std::random_device()()),
+          tick_length(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / FPS))),
+          next_tick(Clock::now() + tick_length),
+          next_report(Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                  std::chrono::duration<double>(MatchServerUtil::REPORT_INTERVAL)))
+{
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        throw std::runtime_error("fatal error: Failed to create server socket");
+    }
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 ||
+        listen(listen_fd, SOMAXCONN) == -1) {
+        close(listen_fd);
+        throw std::runtime_error("fatal error: Failed to listen for clients\nPort: " + std::to_string(port));
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        close(listen_fd);
+        throw std::runtime_error("fatal error: Failed to create epoll instance");
+    }
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+
+    spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+MatchServer::~MatchServer() {
+    for (size_t fd = 0; fd < connections.size(); ++fd) {
+        if (connections[fd].open) {
+            close(static_cast<int>(fd));
+        }
+    }
+    if (spare_fd != -1) {
+        close(spare_fd);
+    }
+    close(epoll_fd);
+    close(listen_fd);
+}
+
+void MatchServer::run() {
+    while (!stopping) {
+        poll(Clock::time_point::max());
+    }
+}
+
+void MatchServer::run_for(double seconds) {
+    Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(seconds));
+    while (!stopping && Clock::now() < end) {
+        poll(end);
+    }
+}
+
+uint16_t MatchServer::get_port() const {
+    sockaddr_in address;
+    socklen_t address_size = sizeof(address);
+    if (getsockname(listen_fd, reinterpret_cast<sockaddr*>(&address), &address_size) == -1) {
+        return 0;
+    }
+    return ntohs(address.sin_port);
+}
+
+void MatchServer::poll(Clock::time_point end) {
+    epoll_event events[MatchServerUtil::MAX_EPOLL_EVENTS];
+
+    Clock::time_point now = Clock::now();
+    Clock::time_point wake = std::min(next_tick, end);
+    int timeout_ms = 0;
+    if (wake > now) {
+        // Rounded up, so the loop does not spin for the last fraction of a millisecond
+        timeout_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count()) + 1;
+    }
+
+    int num_events = epoll_wait(epoll_fd, events, MatchServerUtil::MAX_EPOLL_EVENTS, timeout_ms);
+    for (int i = 0; i < num_events; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == listen_fd) {
+            accept_connections();
+            continue;
+        }
+        if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+            close_connection(fd);
+            continue;
+        }
+        if (events[i].events & EPOLLIN) {
+            read_connection(fd);
+        }
+        if ((events[i].events & EPOLLOUT) && connections[fd].open) {
+            flush_connection(fd);
+        }
+    }
+
+    now = Clock::now();
+    if (now >= next_tick) {
+        host.tick();
+        send_updates();
+
+        // A server which can not keep up drops ticks rather than trying to catch up on all of them
+        next_tick += tick_length;
+        if (now - next_tick > 10 * tick_length) {
+            next_tick = now + tick_length;
+        }
+    }
+
+    if (now >= next_report) {
+        if (print_reports) {
+            print_report();
+        }
+        next_report = now + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(MatchServerUtil::REPORT_INTERVAL));
+    }
+}
+
+void MatchServer::accept_connections() {
+    while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            // The listen socket stays readable while clients wait, so they have to be dealt with
+            // or every poll would wake straight away
+            if ((errno == EMFILE || errno == ENFILE) && turn_away_connection()) {
+                continue;
+            }
+            return; // Nothing left to accept
+        }
+
+        uint32_t match = host.get_slab().allocate(next_seed++, fd);
+        if (match == MatchSlabUtil::NO_MATCH) {
+            close(fd); // Full
+            continue;
+        }
+
+        // Updates are small and should go straight out
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+        if (static_cast<size_t>(fd) >= connections.size()) {
+            connections.resize(fd + 1);
+        }
+        Connection& connection = connections[fd];
+        connection = Connection();
+        connection.open = true;
+        connection.match = match;
+
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+
+        send_message(fd, make_message(MatchProtocol::SERVER_WELCOME, match));
+        host.get_slab()[match].events = 0; // Covered by the welcome
+    }
+}
+
+bool MatchServer::turn_away_connection() {
+    if (spare_fd == -1) {
+        set_listening(false); // Until a connection closes
+        return false;
+    }
+    close(spare_fd);
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    int error = errno;
+    if (fd != -1) {
+        close(fd);
+    }
+    spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1 && (error == EMFILE || error == ENFILE)) {
+        set_listening(false); // The spare was taken by another thread before accept got it
+    }
+    return fd != -1;
+}
+
+void MatchServer::set_listening(bool listen) {
+    if (listen == listening) {
+        return;
+    }
+    listening = listen;
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = listen ? EPOLLIN : 0;
+    event.data.fd = listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, listen_fd, &event);
+}
+
+void MatchServer::read_connection(int fd) {
+    Connection& connection = connections[fd];
+    uint8_t buffer[4096];
+
+    while (connection.open) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close_connection(fd);
+            return;
+        }
+        if (received < 0) {
+            return;
+        }
+
+        // Messages are fixed size, so finish off any split one and then take whole ones
+        size_t offset = 0;
+        while (offset < static_cast<size_t>(received) && connection.open) {
+            size_t wanted = sizeof(MatchProtocol::ClientMessage) - connection.partial_size;
+            size_t taken = std::min(wanted, static_cast<size_t>(received) - offset);
+            std::memcpy(connection.partial + connection.partial_size, buffer + offset, taken);
+            connection.partial_size += taken;
+            offset += taken;
+
+            if (connection.partial_size == sizeof(MatchProtocol::ClientMessage)) {
+                MatchProtocol::ClientMessage message;
+                std::memcpy(&message, connection.partial, sizeof(message));
+                connection.partial_size = 0;
+                handle_message(fd, message);
+            }
+        }
+    }
+}
+
+void MatchServer::handle_message(int fd, const MatchProtocol::ClientMessage& message) {
+    Connection& connection = connections[fd];
+    MatchSlab& slab = host.get_slab();
+
+    switch (message.type) {
+        case MatchProtocol::CLIENT_INPUT :
+            if (message.input != 0 && message.input < SimulationUtil::NUM_INPUTS) {
+                slab.queue_input(connection.match, static_cast<SimulationUtil::Input>(message.input));
+            }
+            break;
+        case MatchProtocol::CLIENT_RESET :
+            slab.restart(connection.match, next_seed++);
+            send_message(fd, make_message(MatchProtocol::SERVER_WELCOME, connection.match));
+            slab[connection.match].events = 0;
+            break;
+        default:
+            close_connection(fd); // Not speaking the protocol
+            break;
+    }
+}
+
+void MatchServer::close_connection(int fd) {
+    Connection& connection = connections[fd];
+    if (!connection.open) {
+        return;
+    }
+    host.get_slab().release(connection.match);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connection = Connection();
+
+    // A descriptor is free again, so whoever is waiting can be let in
+    if (spare_fd == -1) {
+        spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+    set_listening(true);
+}
+
+void MatchServer::send_message(int fd, const MatchProtocol::ServerMessage& message) {
+    Connection& connection = connections[fd];
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&message);
+    connection.output.insert(connection.output.end(), bytes, bytes + sizeof(message));
+
+    if (connection.output.size() > MatchServerUtil::MAX_PENDING_OUTPUT) {
+        close_connection(fd);
+        return;
+    }
+    if (!connection.waiting_to_write) {
+        flush_connection(fd);
+    }
+}
+
+void MatchServer::flush_connection(int fd) {
+    Connection& connection = connections[fd];
+
+    size_t sent_total = 0;
+    while (sent_total < connection.output.size()) {
+        ssize_t sent = send(fd, connection.output.data() + sent_total, connection.output.size() - sent_total,
+                            MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            close_connection(fd);
+            return;
+        }
+        sent_total += static_cast<size_t>(sent);
+    }
+    connection.output.erase(connection.output.begin(), connection.output.begin() + sent_total);
+
+    // Only ask epoll about writability while there is something stuck
+    bool waiting = !connection.output.empty();
+    if (waiting != connection.waiting_to_write) {
+        connection.waiting_to_write = waiting;
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLRDHUP | (waiting ? EPOLLOUT : 0);
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    }
+}
+
+void MatchServer::send_updates() {
+    MatchSlab& slab = host.get_slab();
+    for (uint32_t i = 0; i < slab.get_end(); ++i) {
+        MatchSlabUtil::Match& match = slab[i];
+        if (!match.active || match.events == 0 || match.owner < 0) {
+            continue;
+        }
+        MatchProtocol::ServerMessage message = make_message(MatchProtocol::SERVER_UPDATE, i);
+        match.events = 0;
+        send_message(match.owner, message);
+    }
+}
+
+void MatchServer::print_report() {
+    MatchHostUtil::TickReport report = host.take_report();
+    std::cout << host.get_slab().get_num_active() << " games, "
+              << report.num_ticks << " ticks, "
+              << static_cast<uint64_t>(report.game_ticks_per_second) << " game ticks/s, "
+              << "tick mean " << report.mean_tick_ms << "ms p99 " << report.p99_tick_ms << "ms max "
+              << report.max_tick_ms << "ms" << std::endl;
+}
+
+MatchProtocol::ServerMessage MatchServer::make_message(MatchProtocol::ServerMessageType type, uint32_t match) const {
+    const MatchSlabUtil::Match& game = host.get_slab()[match];
+
+    MatchProtocol::ServerMessage message;
+    std::memset(&message, 0, sizeof(message));
+    message.type = type;
+    message.game_over = game.state.game_over;
+    message.tick = host.get_current_tick();
+    message.seed = game.state.seed;
+    message.events = game.events;
+    message.score = game.state.score;
+    message.lines_cleared = game.state.lines_cleared;
+    return message;
+}
@@ -0,0 +1,84 @@
+#ifndef INC_3D_TETRIS_MATCHSERVER_H
+#define INC_3D_TETRIS_MATCHSERVER_H
+
+#include "MatchHost.h"
+#include "MatchProtocol.h"
+#include "Util/NonCopyable.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace MatchServerUtil {
+    static constexpr int MAX_EPOLL_EVENTS = 256;
+    static constexpr size_t MAX_PENDING_OUTPUT = 64 * 1024; // Clients further behind than this are dropped
+    static constexpr double REPORT_INTERVAL = 5.0; // Seconds between load reports
+}
+
+// Hosts one game per TCP connection, ticking all of them at FPS
+// Connections are handled on a single epoll loop, the games are stepped by the MatchHost's workers
+class MatchServer : public Util::NonCopyable {
+public:
+    MatchServer(uint16_t port, uint32_t max_matches, unsigned int num_workers);
+    ~MatchServer();
+
+    // Runs until stop() is called
+    void run();
+    void stop() { stopping = true; } // Safe from a signal handler
+
+    // Runs for a while and returns, to drive the server from a test on the same thread
+    void run_for(double seconds);
+
+    // Load reports are printed every REPORT_INTERVAL unless turned off, for callers taking their own
+    void set_print_reports(bool print) { print_reports = print; }
+    MatchHostUtil::TickReport take_report() { return host.take_report(); }
+
+    // Getters
+    uint16_t get_port() const; // The one actually bound, for servers started on port 0
+    uint32_t get_num_matches() const { return host.get_slab().get_num_active(); }
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void poll(Clock::time_point end); // Handles what is waiting, and runs the tick if it is due
+    struct Connection {
+        bool open = false;
+        uint32_t match = MatchSlabUtil::NO_MATCH;
+        uint8_t partial[sizeof(MatchProtocol::ClientMessage)]; // Start of a message split across reads
+        size_t partial_size = 0;
+        std::vector<uint8_t> output; // Not yet accepted by the socket
+        bool waiting_to_write = false;
+    };
+
+    void accept_connections();
+    bool turn_away_connection(); // Out of descriptors, so the next waiting client is closed instead. False if none was
+    void set_listening(bool listen); // Turns accepting off while no descriptor can be freed for it
+    void read_connection(int fd);
+    void handle_message(int fd, const MatchProtocol::ClientMessage& message);
+    void close_connection(int fd);
+
+    void send_message(int fd, const MatchProtocol::ServerMessage& message);
+    void flush_connection(int fd);
+    void send_updates(); // After each tick, to the owners of games which changed
+    void print_report();
+
+    MatchProtocol::ServerMessage make_message(MatchProtocol::ServerMessageType type, uint32_t match) const;
+
+    MatchHost host;
+    int listen_fd;
+    int epoll_fd;
+    int spare_fd; // Held open to be given up when out of descriptors, or -1
+    bool listening = true;
+    std::vector<Connection> connections; // By file descriptor
+    uint32_t next_seed;
+
+    Clock::duration tick_length;
+    Clock::time_point next_tick;
+    Clock::time_point next_report;
+    bool print_reports = true;
+
+    std::atomic<bool> stopping{false};
+};
+
+
+#endif //INC_3D_TETRIS_MATCHSERVER_H
@@ -0,0 +1,66 @@
+#include "MatchSlab.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+MatchSlab::MatchSlab(uint32_t capacity) : matches(capacity) {
+    std::memset(matches.data(), 0, matches.size() * sizeof(MatchSlabUtil::Match));
+
+    free_slots.reserve(capacity);
+    for (uint32_t i = capacity; i > 0; --i) {
+        free_slots.push_back(i - 1);
+    }
+    std::make_heap(free_slots.begin(), free_slots.end(), std::greater<uint32_t>());
+}
+
+uint32_t MatchSlab::allocate(uint32_t seed, int32_t owner) {
+    if (free_slots.empty()) {
+        return MatchSlabUtil::NO_MATCH;
+    }
+    std::pop_heap(free_slots.begin(), free_slots.end(), std::greater<uint32_t>());
+    uint32_t index = free_slots.back();
+    free_slots.pop_back();
+
+    MatchSlabUtil::Match& match = matches[index];
+    match.owner = owner;
+    match.active = 1;
+    restart(index, seed);
+
+    ++num_active;
+    end = std::max(end, index + 1);
+    return index;
+}
+
+void MatchSlab::restart(uint32_t index, uint32_t seed) {
+    MatchSlabUtil::Match& match = matches[index];
+    fresh.reset(seed);
+    match.state = fresh.save_state();
+    match.events = fresh.consume_events();
+    match.num_inputs = 0;
+}
+
+void MatchSlab::release(uint32_t index) {
+    MatchSlabUtil::Match& match = matches[index];
+    if (!match.active) {
+        return;
+    }
+    match.active = 0;
+    match.owner = -1;
+    ++match.generation;
+
+    free_slots.push_back(index);
+    std::push_heap(free_slots.begin(), free_slots.end(), std::greater<uint32_t>());
+
+    --num_active;
+    while (end > 0 && !matches[end - 1].active) {
+        --end;
+    }
+}
+
+void MatchSlab::queue_input(uint32_t index, SimulationUtil::Input input) {
+    MatchSlabUtil::Match& match = matches[index];
+    if (match.num_inputs < MatchSlabUtil::MAX_TICK_INPUTS) {
+        match.inputs[match.num_inputs++] = static_cast<uint8_t>(input);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef INC_3D_TETRIS_MATCHSLAB_H
+#define INC_3D_TETRIS_MATCHSLAB_H
+
+#include "Simulation.h"
+#include "Util/NonCopyable.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace MatchSlabUtil {
+    static constexpr uint32_t NO_MATCH = 0xFFFFFFFF;
+    static constexpr uint8_t MAX_TICK_INPUTS = 16; // Inputs past this in one tick are dropped
+
+    // Everything about one game, in one flat block
+    // Games are only ever turned into a Simulation for the length of a tick
+    struct Match {
+        SimulationUtil::State state;
+        uint32_t events;     // SimulationUtil::Event flags not yet sent to the owner
+        uint32_t generation; // Bumped on release, so stale handles can be told apart
+        int32_t  owner;      // Connection playing the game, or -1
+        uint8_t  active;
+        uint8_t  num_inputs;
+        uint8_t  inputs[MAX_TICK_INPUTS]; // For the next tick
+    };
+}
+
+// Fixed pool of games, allocated once up front
+// Slots are handed out lowest first, so the active games stay packed at the front
+class MatchSlab : public Util::NonCopyable {
+public:
+    explicit MatchSlab(uint32_t capacity);
+
+    // Returns MatchSlabUtil::NO_MATCH if the slab is full
+    uint32_t allocate(uint32_t seed, int32_t owner);
+    void restart(uint32_t index, uint32_t seed); // Starts a new game in the same slot
+    void release(uint32_t index);
+
+    void queue_input(uint32_t index, SimulationUtil::Input input);
+
+    MatchSlabUtil::Match& operator[](uint32_t index) { return matches[index]; }
+    const MatchSlabUtil::Match& operator[](uint32_t index) const { return matches[index]; }
+
+    // Getters
+    uint32_t get_capacity() const { return static_cast<uint32_t>(matches.size()); }
+    uint32_t get_num_active() const { return num_active; }
+    uint32_t get_end() const { return end; } // Every active slot is below this
+private:
+    std::vector<MatchSlabUtil::Match> matches;
+    std::vector<uint32_t> free_slots; // Kept as a min-heap
+    uint32_t num_active = 0;
+    uint32_t end = 0;
+
+    Simulation fresh; // Builds the starting state of new games
+};
+
+
+#endif //INC_3D_TETRIS_MATCHSLAB_H
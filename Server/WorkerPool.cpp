@@ -0,0 +1,74 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned int num_workers) {
+    for (unsigned int worker = 1; worker < std::max(num_workers, 1u); ++worker) {
+        threads.emplace_back(&WorkerPool::worker_main, this, worker);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_condition.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(uint32_t new_count, uint32_t new_batch_size, const Job& new_job) {
+    if (new_count == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &new_job;
+        count = new_count;
+        batch_size = std::max(new_batch_size, 1u);
+        next_batch.store(0, std::memory_order_relaxed);
+        num_busy = static_cast<unsigned int>(threads.size());
+        ++round;
+    }
+    start_condition.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_condition.wait(lock, [this] { return num_busy == 0; });
+    job = nullptr;
+}
+
+void WorkerPool::worker_main(unsigned int worker) {
+    uint64_t seen_round = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_condition.wait(lock, [&] { return stopping || round != seen_round; });
+            if (stopping) {
+                return;
+            }
+            seen_round = round;
+        }
+
+        work(worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--num_busy == 0) {
+            done_condition.notify_one();
+        }
+    }
+}
+
+void WorkerPool::work(unsigned int worker) {
+    // Batches are claimed one at a time, so a slow batch does not hold up the rest
+    uint32_t num_batches = (count + batch_size - 1) / batch_size;
+    uint32_t batch;
+    while ((batch = next_batch.fetch_add(1, std::memory_order_relaxed)) < num_batches) {
+        uint32_t begin = batch * batch_size;
+        (*job)(worker, begin, std::min(begin + batch_size, count));
+    }
+}
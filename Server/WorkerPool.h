@@ -0,0 +1,49 @@
+#ifndef INC_3D_TETRIS_WORKERPOOL_H
+#define INC_3D_TETRIS_WORKERPOOL_H
+
+#include "Util/NonCopyable.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads which split a range of work between them in batches
+// The calling thread joins in as worker 0, so a pool of one runs everything inline
+class WorkerPool : public Util::NonCopyable {
+public:
+    // Called with the worker's number and a batch [begin, end)
+    using Job = std::function<void(unsigned int worker, uint32_t begin, uint32_t end)>;
+
+    explicit WorkerPool(unsigned int num_workers);
+    ~WorkerPool();
+
+    // Returns once all of [0, count) has been done
+    void run(uint32_t count, uint32_t batch_size, const Job& job);
+
+    unsigned int get_num_workers() const { return static_cast<unsigned int>(threads.size()) + 1; }
+private:
+    void worker_main(unsigned int worker);
+    void work(unsigned int worker);
+
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable start_condition;
+    std::condition_variable done_condition;
+    uint64_t round = 0;         // Bumped to start the threads on a new run
+    unsigned int num_busy = 0;  // Threads still working on the current run
+    bool stopping = false;
+
+    // The current run, only touched while the threads are working on it
+    const Job* job = nullptr;
+    uint32_t count = 0;
+    uint32_t batch_size = 1;
+    std::atomic<uint32_t> next_batch{0};
+};
+
+
+#endif //INC_3D_TETRIS_WORKERPOOL_H
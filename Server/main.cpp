@@ -0,0 +1,301 @@
+// Headless server hosting many games at once
+//
+// match-server [--port n] [--max-matches n] [--workers n]
+// match-server --load-test [--max-matches n] [--workers n]
+
+#include "MatchServer.h"
+#include "Constants.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    MatchServer* running_server = nullptr;
+
+    void handle_stop_signal(int) {
+        if (running_server != nullptr) {
+            running_server->stop();
+        }
+    }
+
+    // Load test
+    // ---------
+    // Clients run in a child process, so each side has its own descriptor limit and the server is
+    // measured through its real socket path. The two talk over pipes, one u32 at a time:
+    // the parent sends the port, then asks for a total number of clients at a time, and the child
+    // answers with how many got in. Asking for zero ends the test.
+
+    constexpr uint32_t LOAD_STAGES[] = {10, 100, 1000, 2500, 5000, 10000};
+    constexpr double STAGE_SECONDS = 10.0;
+    constexpr double CONNECT_TIMEOUT = 30.0; // Seconds for a stage's clients to be welcomed
+    constexpr uint32_t INPUT_CHANCE = 8; // One input every this many ticks, roughly a player's pace
+    constexpr uint32_t CONNECTS_PER_POLL = 256; // Spread out, so the listen backlog does not overflow
+
+    using Clock = std::chrono::steady_clock;
+
+    void write_u32(int fd, uint32_t value) {
+        if (write(fd, &value, sizeof(value)) != static_cast<ssize_t>(sizeof(value))) {
+            throw std::runtime_error("fatal error: Load test lost its client process");
+        }
+    }
+
+    // Every game is a connection, so the server and the load test clients take as many descriptors as they are allowed
+    void raise_descriptor_limit() {
+        rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+
+    int connect_client(uint16_t port) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1) {
+            return -1;
+        }
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 && errno != EINPROGRESS) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // The child's side, playing every connection with random inputs until told to stop
+    void run_load_clients(int commands, int replies) {
+        uint32_t port;
+        if (read(commands, &port, sizeof(port)) != static_cast<ssize_t>(sizeof(port))) {
+            return;
+        }
+
+        int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = commands;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, commands, &event);
+
+        std::vector<int> clients;
+        std::vector<uint8_t> welcomed; // By descriptor
+        uint32_t num_welcomed = 0;
+        uint32_t target = 0;
+        bool replied = true;
+        bool failed = false; // Out of descriptors or refused, so the stage stops where it is
+        Clock::time_point stage_start;
+
+        RandomNumberUtil::MinStdEngine inputs;
+        inputs.seed(1);
+        const Clock::duration tick_length =
+                std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / FPS));
+        Clock::time_point next_tick = Clock::now();
+
+        epoll_event events[MatchServerUtil::MAX_EPOLL_EVENTS];
+        uint8_t buffer[4096];
+        while (true) {
+            for (uint32_t i = 0; i < CONNECTS_PER_POLL && clients.size() < target && !failed; ++i) {
+                int fd = connect_client(static_cast<uint16_t>(port));
+                if (fd == -1) {
+                    failed = true;
+                    break;
+                }
+                clients.push_back(fd);
+                if (static_cast<size_t>(fd) >= welcomed.size()) {
+                    welcomed.resize(fd + 1, 0);
+                }
+                event.events = EPOLLIN;
+                event.data.fd = fd;
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            }
+            if (!replied && (num_welcomed >= target || (failed && num_welcomed >= clients.size()) ||
+                             std::chrono::duration<double>(Clock::now() - stage_start).count() > CONNECT_TIMEOUT)) {
+                write_u32(replies, num_welcomed);
+                replied = true;
+            }
+
+            int num_events = epoll_wait(epoll_fd, events, MatchServerUtil::MAX_EPOLL_EVENTS, 1);
+            for (int i = 0; i < num_events; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == commands) {
+                    if (read(commands, &target, sizeof(target)) != static_cast<ssize_t>(sizeof(target)) || target == 0) {
+                        for (int client : clients) {
+                            close(client);
+                        }
+                        close(epoll_fd);
+                        return;
+                    }
+                    replied = false;
+                    stage_start = Clock::now();
+                    continue;
+                }
+
+                // Updates are only counted, the first message on a connection is its welcome
+                ssize_t received;
+                while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+                    if (!welcomed[fd]) {
+                        welcomed[fd] = 1;
+                        ++num_welcomed;
+                    }
+                }
+                if (received == 0) {
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr); // Turned away, the server is full
+                }
+            }
+
+            // Players press something every so often
+            if (Clock::now() >= next_tick) {
+                next_tick += tick_length;
+                for (int fd : clients) {
+                    if (welcomed[fd] && inputs() % INPUT_CHANCE == 0) {
+                        MatchProtocol::ClientMessage message = {
+                                MatchProtocol::CLIENT_INPUT,
+                                static_cast<uint8_t>(1 + inputs() % (SimulationUtil::NUM_INPUTS - 1))
+                        };
+                        send(fd, &message, sizeof(message), MSG_NOSIGNAL);
+                    }
+                }
+            }
+        }
+    }
+
+    // Steps the number of connected games up to max_matches, and prints how the server's ticks held up
+    void load_test(uint32_t max_matches, unsigned int num_workers) {
+        raise_descriptor_limit();
+        signal(SIGPIPE, SIG_IGN); // A dead client process fails the next write instead of killing the test
+
+        int commands[2];
+        int replies[2];
+        if (pipe(commands) == -1 || pipe(replies) == -1) {
+            throw std::runtime_error("fatal error: Failed to create load test pipes");
+        }
+
+        // Forked before the server starts its workers, so the child has no threads to worry about
+        pid_t child = fork();
+        if (child == -1) {
+            throw std::runtime_error("fatal error: Failed to start load test clients");
+        }
+        if (child == 0) {
+            close(commands[1]);
+            close(replies[0]);
+            run_load_clients(commands[0], replies[1]);
+            _exit(0);
+        }
+        close(commands[0]);
+        close(replies[1]);
+        fcntl(replies[0], F_SETFL, fcntl(replies[0], F_GETFL, 0) | O_NONBLOCK);
+
+        MatchServer server(0, max_matches, num_workers);
+        server.set_print_reports(false);
+        write_u32(commands[1], server.get_port());
+
+        std::cout << "games\tticks/s\tgame ticks/s\tmean ms\tp99 ms\tmax ms\tfits " << (1000.0 / FPS) << "ms tick\n";
+        for (uint32_t stage : LOAD_STAGES) {
+            if (stage > max_matches) {
+                break;
+            }
+
+            // The server keeps ticking while the clients connect
+            write_u32(commands[1], stage);
+            uint32_t connected;
+            while (true) {
+                ssize_t received = read(replies[0], &connected, sizeof(connected));
+                if (received == static_cast<ssize_t>(sizeof(connected))) {
+                    break;
+                }
+                // Pipe writes this small are never split, so anything but nothing yet means the child is gone
+                if (received >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    throw std::runtime_error("fatal error: Load test lost its client process");
+                }
+                server.run_for(0.05);
+            }
+
+            server.take_report();
+            server.run_for(STAGE_SECONDS);
+            MatchHostUtil::TickReport report = server.take_report();
+
+            std::cout << server.get_num_matches() << "\t" << report.num_ticks / STAGE_SECONDS << "\t"
+                      << static_cast<uint64_t>(report.game_ticks_per_second) << "\t"
+                      << report.mean_tick_ms << "\t" << report.p99_tick_ms << "\t" << report.max_tick_ms << "\t"
+                      << (report.p99_tick_ms * FPS < 1000.0 ? "yes" : "no") << std::endl;
+            if (connected < stage) {
+                std::cout << "Only " << connected << " of " << stage << " clients got in, stopping\n";
+                break;
+            }
+        }
+
+        write_u32(commands[1], 0);
+        waitpid(child, nullptr, 0);
+        close(commands[1]);
+        close(replies[0]);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    uint16_t port = MatchProtocol::DEFAULT_PORT;
+    uint32_t max_matches = 10000;
+    unsigned int num_workers = std::max(std::thread::hardware_concurrency(), 1u);
+    bool run_load_test = false;
+
+    // Parse command line options
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        } else if (arg == "--max-matches" && i + 1 < argc) {
+            max_matches = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (arg == "--workers" && i + 1 < argc) {
+            num_workers = static_cast<unsigned int>(std::atoi(argv[++i]));
+        } else if (arg == "--load-test") {
+            run_load_test = true;
+        }
+    }
+
+    if (run_load_test) {
+        try {
+            load_test(max_matches, num_workers);
+        } catch (std::runtime_error& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    raise_descriptor_limit();
+    try {
+        MatchServer server(port, max_matches, num_workers);
+        running_server = &server;
+        signal(SIGINT, handle_stop_signal);
+        signal(SIGTERM, handle_stop_signal);
+
+        std::cout << "Hosting up to " << max_matches << " games on port " << port << " with "
+                  << num_workers << " workers" << std::endl;
+        server.run();
+        running_server = nullptr;
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,54 +1,67 @@
 #version 330 core
 
+// Built into one program per pass, with exactly one of TEXT_PASS, BLOCK_PASS or GHOST_PASS defined
+
 in vec2 tex_coords;
+flat in vec4 instance_color; // Blocks only
 
 out vec4 out_color;
 
 uniform sampler2D block_texture;
+
+#ifdef TEXT_PASS
+
 uniform vec4 color;
-uniform bool in_text_mode;
 
 void main() {
-    if (!in_text_mode) {
-        vec3 processed_color;
-        processed_color.r = float(color.r) * texture(block_texture, tex_coords).r;
-        processed_color.g = float(color.g) * texture(block_texture, tex_coords).r;
-        processed_color.b = float(color.b) * texture(block_texture, tex_coords).r;
-
-        // This clamp with desaturation algorithm was taken from Bisqwit with his permission
-        // The original source can be found via the link below:
-        // https://gist.github.com/bisqwit/6fa30964eacefeea2954e5c42c966114
-        float l = dot(processed_color, vec3(0.29900,  0.58700,  0.11400));
-        if (l > 255.0f) {
-            processed_color = vec3(1.0f, 1.0f, 1.0f);
-        } else if (l <= 0.0f) {
-            processed_color = vec3(0.0f, 0.0f, 0.0f);
-        } else {
-            float s = 1.0f;
-            for (int n = 0; n < 3; ++n) {
-                if (processed_color[n] > 255.0f) {
-                    s = min(s, (l - 255.0f) / (l - processed_color[n]));
-                } else if (processed_color[n] < 0.0f) {
-                    s = min(s, l / (l - processed_color[n]));
-                }
-            }
+    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(block_texture, tex_coords).r);
+    out_color = color * sampled;
+}
+
+#else
 
-            if (s != 1.0f) {
-                for (int i = 0; i < 3; ++i) {
-                    processed_color[i] = (processed_color[i] - l) * s + l;
-                }
+#ifdef OVERBRIGHT_COLORS
+// Only needed for colours which can go over 255, which block colours times the texture never do
+vec3 clamp_with_desaturation(vec3 processed_color) {
+    // This clamp with desaturation algorithm was taken from Bisqwit with his permission
+    // The original source can be found via the link below:
+    // https://gist.github.com/bisqwit/6fa30964eacefeea2954e5c42c966114
+    float l = dot(processed_color, vec3(0.29900,  0.58700,  0.11400));
+    if (l > 255.0f) {
+        processed_color = vec3(1.0f, 1.0f, 1.0f);
+    } else if (l <= 0.0f) {
+        processed_color = vec3(0.0f, 0.0f, 0.0f);
+    } else {
+        float s = 1.0f;
+        for (int n = 0; n < 3; ++n) {
+            if (processed_color[n] > 255.0f) {
+                s = min(s, (l - 255.0f) / (l - processed_color[n]));
+            } else if (processed_color[n] < 0.0f) {
+                s = min(s, l / (l - processed_color[n]));
             }
         }
 
-        processed_color.r = processed_color.r / 255.0f;
-        processed_color.g = processed_color.g / 255.0f;
-        processed_color.b = processed_color.b / 255.0f;
-
-        out_color = vec4(processed_color, float(color.a) / 100);
-    } else {
-        vec4 sampled = vec4(1.0, 1.0, 1.0, texture(block_texture, tex_coords).r);
-        out_color = color * sampled;
+        if (s != 1.0f) {
+            for (int i = 0; i < 3; ++i) {
+                processed_color[i] = (processed_color[i] - l) * s + l;
+            }
+        }
     }
+    return processed_color;
+}
+#endif
 
+void main() {
+    vec3 processed_color = instance_color.rgb * texture(block_texture, tex_coords).r;
+#ifdef OVERBRIGHT_COLORS
+    processed_color = clamp_with_desaturation(processed_color);
+#endif
 
+#ifdef GHOST_PASS
+    out_color = vec4(processed_color / 255.0f, GHOST_ALPHA);
+#else
+    out_color = vec4(processed_color / 255.0f, instance_color.a / 100.0f);
+#endif
 }
+
+#endif
@@ -3,7 +3,13 @@
 layout (location = 0) in vec3 pos;
 layout (location = 1) in vec2 texture_coords;
 
+// Per block instance, left at their defaults of zero and (0, 0, 0, 1) for text
+// The landed stack has its colour per vertex and no position
+layout (location = 2) in vec2 block_position;
+layout (location = 3) in vec4 block_color;
+
 out vec2 tex_coords;
+flat out vec4 instance_color;
 
 // Constants
 uniform int SCREEN_WIDTH;
@@ -11,11 +17,15 @@ uniform int SCREEN_HEIGHT;
 uniform int BLOCK_SIZE;
 
 // Matrix transformations
+// The camera is shared by every draw and only updated when it moves
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+};
 
 void main() {
-	gl_Position = projection * view * model * vec4(pos, 1.0);
+	gl_Position = projection * view * model * vec4(pos + vec3(block_position, 0.0), 1.0);
 	tex_coords = texture_coords;
+	instance_color = block_color;
 }
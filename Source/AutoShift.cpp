@@ -0,0 +1,81 @@
+#include "AutoShift.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+AutoShift::AutoShift(double das_seconds, double arr_seconds) : das(das_seconds), arr(arr_seconds) {
+}
+
+void AutoShift::press(AutoShiftUtil::Direction direction, double time) {
+    advance(time);
+
+    // The first move is made by the key press itself
+    held[direction] = true;
+    active = direction;
+    next_repeat = time + das;
+}
+
+void AutoShift::release(AutoShiftUtil::Direction direction, double time) {
+    using namespace AutoShiftUtil;
+
+    advance(time);
+
+    held[direction] = false;
+    if (active != direction) {
+        return;
+    }
+
+    // Fall back to the other direction if it is still held, charging up again from now
+    Direction other = direction == LEFT ? RIGHT : LEFT;
+    if (held[other]) {
+        active = other;
+        next_repeat = time + das;
+    } else {
+        active = NONE;
+    }
+}
+
+void AutoShift::reset() {
+    held[AutoShiftUtil::LEFT] = held[AutoShiftUtil::RIGHT] = false;
+    active = AutoShiftUtil::NONE;
+    pending_begin = pending_end = 0;
+}
+
+void AutoShift::advance(double until) {
+    using namespace AutoShiftUtil;
+
+    if (active == NONE || next_repeat > until) {
+        return;
+    }
+
+    // Straight to the wall, and nothing more until the direction changes
+    if (arr <= 0.0) {
+        queue_moves(active, WALL_MOVES);
+        next_repeat = std::numeric_limits<double>::infinity();
+        return;
+    }
+
+    // Every repeat due by now, however many ticks late this is
+    double repeats = std::floor((until - next_repeat) / arr) + 1.0;
+    next_repeat += repeats * arr;
+    queue_moves(active, static_cast<uint32_t>(std::min(repeats, static_cast<double>(MAX_PENDING_MOVES))));
+}
+
+bool AutoShift::take_move(SimulationUtil::Input& input) {
+    if (pending_begin == pending_end) {
+        pending_begin = pending_end = 0;
+        return false;
+    }
+    input = pending[pending_begin++];
+    return true;
+}
+
+void AutoShift::queue_moves(AutoShiftUtil::Direction direction, uint32_t count) {
+    // More than a wall's worth of moves at once can only be after a stall, and goes no further anyway
+    SimulationUtil::Input input = direction == AutoShiftUtil::LEFT ? SimulationUtil::Input::LEFT :
+                                                                    SimulationUtil::Input::RIGHT;
+    while (count-- != 0 && pending_end < AutoShiftUtil::MAX_PENDING_MOVES) {
+        pending[pending_end++] = input;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef INC_3D_TETRIS_AUTOSHIFT_H
+#define INC_3D_TETRIS_AUTOSHIFT_H
+
+#include "Simulation.h"
+
+#include <cstdint>
+
+namespace AutoShiftUtil {
+    static constexpr double DEFAULT_DAS = 0.167; // Seconds a direction is held before it starts repeating
+    static constexpr double DEFAULT_ARR = 0.033; // Seconds between repeats, zero goes straight to the wall
+
+    static constexpr uint32_t MAX_PENDING_MOVES = 16;
+    static constexpr uint32_t WALL_MOVES = GAME_WIDTH - 1; // Enough to cross the board from wall to wall
+
+    enum Direction : uint8_t {
+        LEFT  = 0,
+        RIGHT = 1,
+        NONE  = 2,
+    };
+}
+
+// Turns a held left or right key into repeated moves, timed from the key event timestamps
+// rather than the OS key repeat, so the repeats land on the tick they were due whatever the frame rate.
+// The repeats come out as plain moves, so replays, versus and the flight recorder see nothing new.
+class AutoShift {
+public:
+    AutoShift(double das_seconds, double arr_seconds);
+
+    // Key events, in the order they were received
+    void press(AutoShiftUtil::Direction direction, double time);
+    void release(AutoShiftUtil::Direction direction, double time);
+    void reset(); // Forgets held keys, the keys have to be pressed again to repeat
+
+    // Queues the repeats which came due by the given time
+    void advance(double until);
+
+    // Returns false when there are no moves queued
+    bool take_move(SimulationUtil::Input& input);
+private:
+    void queue_moves(AutoShiftUtil::Direction direction, uint32_t count);
+
+    double das;
+    double arr;
+
+    bool held[2] = {false, false};
+    AutoShiftUtil::Direction active = AutoShiftUtil::NONE; // The most recently pressed direction still held
+    double next_repeat = 0.0;
+
+    SimulationUtil::Input pending[AutoShiftUtil::MAX_PENDING_MOVES];
+    uint32_t pending_begin = 0;
+    uint32_t pending_end = 0;
+};
+
+
+#endif //INC_3D_TETRIS_AUTOSHIFT_H
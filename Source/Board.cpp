@@ -0,0 +1,70 @@
+#include "Board.h"
+
+#include <cstring>
+
+void Board::load(const BoardUtil::Cell* source) {
+    std::memcpy(cells.data(), source, size_in_bytes());
+}
+
+bool Board::in_bounds(const glm::ivec2 &cell) const {
+    return cell.x >= 0 && cell.x < static_cast<int>(GAME_WIDTH) &&
+           cell.y >= 0 && cell.y < static_cast<int>(GAME_HEIGHT);
+}
+
+bool Board::occupied(const glm::ivec2 &cell) const {
+    return in_bounds(cell) && cells[cell.y * GAME_WIDTH + cell.x] != BoardUtil::EMPTY_CELL;
+}
+
+BoardUtil::Cell Board::get(const glm::ivec2 &cell) const {
+    if (!in_bounds(cell)) {
+        return BoardUtil::EMPTY_CELL;
+    }
+    return cells[cell.y * GAME_WIDTH + cell.x];
+}
+
+void Board::set(const glm::ivec2 &cell, BoardUtil::Cell value) {
+    if (in_bounds(cell)) {
+        cells[cell.y * GAME_WIDTH + cell.x] = value;
+    }
+}
+
+bool Board::row_full(int y) const {
+    for (unsigned int x = 0; x < GAME_WIDTH; ++x) {
+        if (cells[y * GAME_WIDTH + x] == BoardUtil::EMPTY_CELL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Board::remove_row(int y) {
+    // Rows are contiguous, so everything above the removed row moves down in one go
+    std::memmove(&cells[GAME_WIDTH], &cells[0], y * GAME_WIDTH * sizeof(BoardUtil::Cell));
+    std::memset(&cells[0], BoardUtil::EMPTY_CELL, GAME_WIDTH * sizeof(BoardUtil::Cell));
+}
+
+bool Board::insert_garbage(unsigned int rows, unsigned int hole) {
+    if (rows > GAME_HEIGHT) {
+        rows = GAME_HEIGHT;
+    }
+
+    bool overflowed = highest_occupied_row() < static_cast<int>(rows);
+
+    std::memmove(&cells[0], &cells[rows * GAME_WIDTH], (GAME_HEIGHT - rows) * GAME_WIDTH * sizeof(BoardUtil::Cell));
+    for (unsigned int y = GAME_HEIGHT - rows; y < GAME_HEIGHT; ++y) {
+        for (unsigned int x = 0; x < GAME_WIDTH; ++x) {
+            cells[y * GAME_WIDTH + x] = (x == hole) ? BoardUtil::EMPTY_CELL : BoardUtil::GARBAGE_CELL;
+        }
+    }
+
+    return !overflowed;
+}
+
+int Board::highest_occupied_row() const {
+    for (unsigned int i = 0; i < BoardUtil::NUM_CELLS; ++i) {
+        if (cells[i] != BoardUtil::EMPTY_CELL) {
+            return i / GAME_WIDTH;
+        }
+    }
+    return GAME_HEIGHT;
+}
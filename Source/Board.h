@@ -0,0 +1,60 @@
+#ifndef INC_3D_TETRIS_BOARD_H
+#define INC_3D_TETRIS_BOARD_H
+
+#include "Constants.h"
+#include "Tetromino.h"
+
+#include <array>
+#include <cstdint>
+#include <glm/vec2.hpp>
+
+namespace BoardUtil {
+    // A cell holds the type of the tetromino which landed in it offset by one,
+    // so that zero can represent an empty cell
+    using Cell = uint8_t;
+    static constexpr Cell EMPTY_CELL = 0;
+    static constexpr unsigned int NUM_CELLS = GAME_WIDTH * GAME_HEIGHT;
+
+    constexpr Cell cell_from_type(TetrominoUtil::TetrominoType type) {
+        return static_cast<Cell>(static_cast<int>(type) + 1);
+    }
+    inline TetrominoUtil::TetrominoType type_from_cell(Cell cell) {
+        return static_cast<TetrominoUtil::TetrominoType>(cell - 1);
+    }
+
+    // Rows sent over by the opponent in versus are drawn like blocks
+    static constexpr Cell GARBAGE_CELL = cell_from_type(TetrominoUtil::TetrominoType::BLOCK);
+}
+
+// The landed stack, stored row by row as one contiguous block of cells
+// so that it can be handed out or copied without any serialisation
+class Board {
+public:
+    Board() { clear(); }
+
+    void clear() { cells.fill(BoardUtil::EMPTY_CELL); }
+    void load(const BoardUtil::Cell* source); // Copies in a whole board laid out like data()
+
+    bool in_bounds(const glm::ivec2& cell) const;
+    bool occupied(const glm::ivec2& cell) const; // Cells out of bounds are never occupied
+    BoardUtil::Cell get(const glm::ivec2& cell) const;
+    void set(const glm::ivec2& cell, BoardUtil::Cell value);
+
+    bool row_full(int y) const;
+    void remove_row(int y); // Removes the row and moves every row above it down by one
+
+    // Moves every row up and fills the bottom rows with garbage, leaving a hole in one column
+    // Returns false if anything was pushed off the top
+    bool insert_garbage(unsigned int rows, unsigned int hole);
+
+    int highest_occupied_row() const; // Returns GAME_HEIGHT if the board is empty
+
+    // Getters
+    const BoardUtil::Cell* data() const { return cells.data(); }
+    static constexpr unsigned int size_in_bytes() { return BoardUtil::NUM_CELLS * sizeof(BoardUtil::Cell); }
+private:
+    std::array<BoardUtil::Cell, BoardUtil::NUM_CELLS> cells;
+};
+
+
+#endif //INC_3D_TETRIS_BOARD_H
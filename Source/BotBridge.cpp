@@ -0,0 +1,76 @@
+#include "BotBridge.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <new>
+#include <stdexcept>
+
+BotBridge::BotBridge(const std::string& shm_name) : name(shm_name) {
+    // Remove any region left behind by a previous run
+    shm_unlink(name.c_str());
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        throw std::runtime_error(std::string("fatal error: Failed to create bot shared memory\nName: ") + name);
+    }
+
+    if (ftruncate(fd, sizeof(BotProtocol::SharedRegion)) == -1) {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("fatal error: Failed to size bot shared memory");
+    }
+
+    void* mapping = mmap(nullptr, sizeof(BotProtocol::SharedRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the region alive
+    if (mapping == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("fatal error: Failed to map bot shared memory");
+    }
+
+    // The game creates the region, so it is the side which constructs the rings
+    region = new (mapping) BotProtocol::SharedRegion;
+    region->version = BotProtocol::VERSION;
+
+    // Magic is written last so a bot never attaches to a half initialised region
+    region->magic.store(BotProtocol::MAGIC, std::memory_order_release);
+}
+
+BotBridge::~BotBridge() {
+    region->magic.store(0, std::memory_order_release);
+    region->~SharedRegion();
+    munmap(region, sizeof(BotProtocol::SharedRegion));
+    shm_unlink(name.c_str());
+}
+
+BotProtocol::Snapshot* BotBridge::begin_snapshot() {
+    // Sequence moves on even if the snapshot is skipped,
+    // so commands for the previous tetromino are still discarded
+    ++sequence;
+
+    BotProtocol::Snapshot* snapshot = region->snapshots.begin_push();
+    if (snapshot != nullptr) {
+        snapshot->sequence = sequence;
+    }
+    return snapshot;
+}
+
+void BotBridge::publish_snapshot() {
+    region->snapshots.end_push();
+}
+
+bool BotBridge::fetch_command(BotProtocol::Command& command) {
+    const BotProtocol::CommandMessage* message;
+    while ((message = region->commands.front()) != nullptr) {
+        bool current = (message->snapshot_sequence == sequence);
+        command = static_cast<BotProtocol::Command>(message->command);
+        region->commands.pop();
+
+        // Drop commands the bot computed for a tetromino which has already landed
+        if (current) {
+            return true;
+        }
+    }
+    return false;
+}
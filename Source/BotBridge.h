@@ -0,0 +1,31 @@
+#ifndef INC_3D_TETRIS_BOTBRIDGE_H
+#define INC_3D_TETRIS_BOTBRIDGE_H
+
+#include "BotProtocol.h"
+#include "Util/NonCopyable.h"
+
+#include <string>
+
+// Owns the POSIX shared memory region external bots attach to
+// Snapshots are written straight into the ring slot the bot reads from
+class BotBridge : public Util::NonCopyable {
+public:
+    explicit BotBridge(const std::string& shm_name);
+    ~BotBridge();
+
+    // Returns the snapshot slot to fill in, or nullptr if the bot has fallen behind
+    // publish_snapshot() must only be called when a slot was returned
+    BotProtocol::Snapshot* begin_snapshot();
+    void publish_snapshot();
+
+    // Returns false once there are no commands left for the latest snapshot
+    bool fetch_command(BotProtocol::Command& command);
+private:
+    std::string name;
+    BotProtocol::SharedRegion* region;
+
+    uint32_t sequence = 0;
+};
+
+
+#endif //INC_3D_TETRIS_BOTBRIDGE_H
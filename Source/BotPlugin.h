@@ -0,0 +1,64 @@
+/*
+ * Stable C ABI for in-process bot plugins
+ *
+ * A plugin is a shared library exporting the three functions declared below.
+ * The game loads it at runtime with dlopen and calls tetris_bot_suggest_move
+ * each time a new tetromino spawns. The board view points straight at the
+ * game's own board memory, so it is only valid for the duration of the call
+ * and must not be written to.
+ *
+ * Only ever add fields to the end of the structs and bump TETRIS_BOT_ABI_VERSION.
+ */
+
+#ifndef INC_3D_TETRIS_BOTPLUGIN_H
+#define INC_3D_TETRIS_BOTPLUGIN_H
+
+#include <stdint.h>
+
+#define TETRIS_BOT_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tetris_board_view {
+    uint32_t abi_version;
+    int32_t  width;
+    int32_t  height;
+    const uint8_t* cells;      /* Row major, zero is empty, otherwise tetromino type + 1 */
+
+    uint8_t  current_type;     /* Active tetromino */
+    uint8_t  current_rotation;
+    int8_t   current_x;        /* Top left point of the 4x4 space the tetromino resides in */
+    int8_t   current_y;
+    uint16_t rotation_masks[4]; /* 4x4 block masks for each rotation state, bit (y * 4 + x) */
+
+    uint32_t score;
+} tetris_board_view;
+
+typedef struct tetris_bot_move {
+    uint8_t rotations;         /* Right rotations to apply first */
+    int8_t  shift;             /* Columns to move afterwards, negative is left */
+    uint8_t hard_drop;         /* Non zero to drop the tetromino straight away */
+} tetris_bot_move;
+
+/* Returns zero on success. Called once after the library is loaded */
+int  tetris_bot_init(uint32_t abi_version);
+
+/* Returns zero if a move was written. queue holds the upcoming tetromino types */
+int  tetris_bot_suggest_move(const tetris_board_view* board,
+                             const uint8_t* queue, uint32_t queue_length,
+                             tetris_bot_move* move);
+
+/* Called once before the library is unloaded */
+void tetris_bot_shutdown(void);
+
+typedef int  (*tetris_bot_init_fn)(uint32_t);
+typedef int  (*tetris_bot_suggest_move_fn)(const tetris_board_view*, const uint8_t*, uint32_t, tetris_bot_move*);
+typedef void (*tetris_bot_shutdown_fn)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_3D_TETRIS_BOTPLUGIN_H */
@@ -0,0 +1,104 @@
+#include "BotPluginHost.h"
+
+#include <dlfcn.h>
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+BotPluginHost::BotPluginHost(const std::string& library_path, double limit)
+        : path(library_path),
+          time_limit(limit)
+{
+    library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (library == nullptr) {
+        throw std::runtime_error(std::string("fatal error: Failed to load bot plugin\nPlugin path: ") + path +
+                                 "\n" + dlerror());
+    }
+
+    init_fn         = reinterpret_cast<tetris_bot_init_fn>(dlsym(library, "tetris_bot_init"));
+    suggest_move_fn = reinterpret_cast<tetris_bot_suggest_move_fn>(dlsym(library, "tetris_bot_suggest_move"));
+    shutdown_fn     = reinterpret_cast<tetris_bot_shutdown_fn>(dlsym(library, "tetris_bot_shutdown"));
+    if (init_fn == nullptr || suggest_move_fn == nullptr || shutdown_fn == nullptr) {
+        dlclose(library);
+        throw std::runtime_error(std::string("fatal error: Bot plugin does not export the bot ABI\nPlugin path: ") + path);
+    }
+
+    if (init_fn(TETRIS_BOT_ABI_VERSION) != 0) {
+        dlclose(library);
+        throw std::runtime_error(std::string("fatal error: Bot plugin failed to initialise\nPlugin path: ") + path);
+    }
+}
+
+BotPluginHost::~BotPluginHost() {
+    shutdown_fn();
+    dlclose(library);
+
+#ifndef NDEBUG
+    std::cerr << "Bot plugin: " << calls << " calls, "
+              << mean_call_time() * 1e6 << "us mean, "
+              << longest_call_time * 1e6 << "us max, "
+              << overruns << " over the " << time_limit * 1e6 << "us limit\n";
+#endif
+}
+
+bool BotPluginHost::suggest_move(const Board& board,
+                                 const Tetromino& current,
+                                 const std::array<TetrominoUtil::TetrominoType, NEXT_QUEUE_SIZE>& next_queue,
+                                 unsigned int score,
+                                 tetris_bot_move& move) {
+    if (disabled) {
+        return false;
+    }
+
+    // The view points at the board itself, nothing is serialised
+    tetris_board_view view;
+    view.abi_version = TETRIS_BOT_ABI_VERSION;
+    view.width  = GAME_WIDTH;
+    view.height = GAME_HEIGHT;
+    view.cells  = board.data();
+    view.current_type     = static_cast<uint8_t>(current.get_type());
+    view.current_rotation = static_cast<uint8_t>(current.get_rotation_state());
+    view.current_x = static_cast<int8_t>(current.get_top_left_point().x);
+    view.current_y = static_cast<int8_t>(current.get_top_left_point().y);
+    for (int r = 0; r < 4; ++r) {
+        uint16_t mask = 0;
+        for (auto& b : Tetromino::relative_blocks(current.get_type(), r)) {
+            mask |= 1u << (b.y * 4 + b.x);
+        }
+        view.rotation_masks[r] = mask;
+    }
+    view.score = score;
+
+    uint8_t queue[NEXT_QUEUE_SIZE];
+    for (unsigned int i = 0; i < NEXT_QUEUE_SIZE; ++i) {
+        queue[i] = static_cast<uint8_t>(next_queue[i]);
+    }
+
+    // Time the call
+    auto start = std::chrono::steady_clock::now();
+    int result = suggest_move_fn(&view, queue, NEXT_QUEUE_SIZE, &move);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ++calls;
+    total_call_time += elapsed;
+    if (elapsed > longest_call_time) {
+        longest_call_time = elapsed;
+    }
+
+    // A call cannot be interrupted in process, so a late move is thrown away instead
+    if (elapsed > time_limit) {
+        ++overruns;
+        if (++consecutive_overruns >= MAX_CONSECUTIVE_OVERRUNS) {
+            disabled = true;
+#ifndef NDEBUG
+            std::cerr << "Bot plugin: disabled after " << MAX_CONSECUTIVE_OVERRUNS
+                      << " calls in a row went over the time limit\n";
+#endif
+        }
+        return false;
+    }
+    consecutive_overruns = 0;
+
+    return result == 0;
+}
@@ -0,0 +1,54 @@
+#ifndef INC_3D_TETRIS_BOTPLUGINHOST_H
+#define INC_3D_TETRIS_BOTPLUGINHOST_H
+
+#include "BotPlugin.h"
+#include "Board.h"
+#include "Tetromino.h"
+#include "Util/NonCopyable.h"
+
+#include <array>
+#include <string>
+
+// Loads a bot plugin with dlopen and calls into it with a view of the live board
+class BotPluginHost : public Util::NonCopyable {
+public:
+    BotPluginHost(const std::string& library_path, double time_limit);
+    ~BotPluginHost();
+
+    // Returns false if the plugin gave no move, took longer than the time limit, or has been disabled
+    bool suggest_move(const Board& board,
+                      const Tetromino& current,
+                      const std::array<TetrominoUtil::TetrominoType, NEXT_QUEUE_SIZE>& next_queue,
+                      unsigned int score,
+                      tetris_bot_move& move);
+
+    // Getters, for the call timing shown while the plugin plays
+    bool is_disabled() const { return disabled; }
+    unsigned long num_calls() const { return calls; }
+    unsigned long num_overruns() const { return overruns; }
+    double mean_call_time() const { return calls == 0 ? 0.0 : total_call_time / calls; }
+    double max_call_time() const { return longest_call_time; }
+private:
+    // Plugins which keep missing the time limit are switched off
+    static constexpr int MAX_CONSECUTIVE_OVERRUNS = 3;
+
+    std::string path;
+    void* library;
+
+    tetris_bot_init_fn         init_fn;
+    tetris_bot_suggest_move_fn suggest_move_fn;
+    tetris_bot_shutdown_fn     shutdown_fn;
+
+    double time_limit; // Seconds
+    bool disabled = false;
+
+    // Call timing
+    unsigned long calls = 0;
+    unsigned long overruns = 0;
+    int consecutive_overruns = 0;
+    double total_call_time = 0.0;
+    double longest_call_time = 0.0;
+};
+
+
+#endif //INC_3D_TETRIS_BOTPLUGINHOST_H
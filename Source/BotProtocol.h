@@ -0,0 +1,65 @@
+// Layout of the shared memory region used to talk to external bot processes
+// Included by both the game and the bots, so it must stay free of GL and GLFW
+
+#ifndef INC_3D_TETRIS_BOTPROTOCOL_H
+#define INC_3D_TETRIS_BOTPROTOCOL_H
+
+#include "Constants.h"
+#include "Util/SpscRing.h"
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace BotProtocol {
+    static constexpr uint32_t MAGIC   = 0x54334442; // "T3DB"
+    static constexpr uint32_t VERSION = 1;
+
+    static constexpr uint32_t SNAPSHOT_SLOTS = 4;
+    static constexpr uint32_t COMMAND_SLOTS  = 64;
+
+    enum Command : uint8_t {
+        NONE      = 0,
+        LEFT      = 1,
+        RIGHT     = 2,
+        ROTATE    = 3,
+        SOFT_DROP = 4,
+        HARD_DROP = 5,
+    };
+
+    // Published by the game whenever a new tetromino spawns
+    struct Snapshot {
+        uint32_t sequence;       // Increases by one for every published snapshot
+        uint32_t score;
+        uint8_t  game_over;
+
+        // Active tetromino
+        uint8_t  current_type;   // TetrominoUtil::TetrominoType
+        uint8_t  current_rotation;
+        int8_t   current_x;      // Top left point of the 4x4 space the tetromino resides in
+        int8_t   current_y;
+        uint16_t rotation_masks[4]; // 4x4 block masks for each rotation state, bit (y * 4 + x)
+
+        uint8_t  next[NEXT_QUEUE_SIZE]; // Upcoming tetromino types
+
+        uint8_t  cells[GAME_WIDTH * GAME_HEIGHT]; // Row major, zero is empty, otherwise type + 1
+    };
+
+    // Sent by the bot. Commands for an out of date snapshot are discarded
+    struct CommandMessage {
+        uint32_t snapshot_sequence;
+        uint8_t  command;
+    };
+
+    struct SharedRegion {
+        std::atomic<uint32_t> magic; // Set once the region is ready, cleared when the game exits
+        uint32_t version;
+
+        Util::SpscRing<Snapshot, SNAPSHOT_SLOTS>      snapshots; // Game -> bot
+        Util::SpscRing<CommandMessage, COMMAND_SLOTS> commands;  // Bot -> game
+    };
+
+    static_assert(std::is_trivially_copyable<Snapshot>::value, "Snapshot must be readable in place");
+}
+
+#endif //INC_3D_TETRIS_BOTPROTOCOL_H
@@ -14,12 +14,37 @@ static constexpr unsigned int SCREEN_HEIGHT = 580;
 
 static constexpr unsigned int FPS = 60;
 
-static constexpr float ROTATION_INCREMENT = 0.007f;
+// Ticks run at most per wake of the simulation thread
+// After a stall the game falls behind the clock instead of running hundreds of ticks at once
+static constexpr unsigned int MAX_CATCH_UP_TICKS = 5;
+
+// Frames drawn by --benchmark unless told otherwise, a minute of play
+static constexpr unsigned int BENCHMARK_FRAMES = 60 * FPS;
+
+// Frames per second drawn while paused or on the game over screen, when only the view is moving
+static constexpr double IDLE_FPS = 20.0;
+
+// Radians per second the view turns while paused or on the game over screen
+static constexpr float ROTATION_SPEED = 0.42f;
 static constexpr float DISTANCE_BETWEEN_CAMERA_AND_GAME = 2.6f;
 
 static constexpr int MAX_NUM_SFX_SOURCES = 10;
 
+// Number of upcoming tetrominos known in advance
+static constexpr unsigned int NEXT_QUEUE_SIZE = 3;
+
+// Seconds a bot plugin may spend suggesting a move
+static constexpr double BOT_PLUGIN_TIME_LIMIT = 0.002;
+
 // Seconds till the current tetromino moves down
 static constexpr double TIME_BETWEEN_TETROMINO_MOVEMENTS = 0.5;
+static constexpr unsigned int TICKS_BETWEEN_TETROMINO_MOVEMENTS =
+        static_cast<unsigned int>(TIME_BETWEEN_TETROMINO_MOVEMENTS * FPS);
+
+// Ticks between full state snapshots in a replay
+static constexpr unsigned int REPLAY_KEYFRAME_INTERVAL = 10 * FPS;
+
+// Scores kept in the high score table
+static constexpr unsigned int HIGH_SCORE_TABLE_SIZE = 100;
 
 #endif //INC_3D_TETRIS_CONSTANTS_H
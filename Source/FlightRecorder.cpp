@@ -0,0 +1,268 @@
+#include "FlightRecorder.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+
+FlightRecorder* FlightRecorder::installed = nullptr;
+
+namespace {
+    // Crash signals which leave the process able to run a handler
+    const int CRASH_SIGNALS[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+    constexpr size_t CRASH_HANDLER_STACK_SIZE = 64 * 1024;
+
+    // Stack overflows crash on the normal stack, so the handler runs on one of its own
+    // The alternate stack belongs to a thread, so every thread which can crash needs one
+    struct AltStack {
+        std::unique_ptr<char[]> memory;
+
+        ~AltStack() {
+            if (memory) {
+                stack_t stack;
+                stack.ss_sp = nullptr;
+                stack.ss_size = 0;
+                stack.ss_flags = SS_DISABLE;
+                sigaltstack(&stack, nullptr);
+            }
+        }
+    };
+    thread_local AltStack alt_stack;
+
+    void copy_path(char* destination, size_t size, const std::string& path) {
+        std::strncpy(destination, path.c_str(), size - 1);
+        destination[size - 1] = '\0';
+    }
+
+    // Async-signal-safe replacements for the bits of stdio which are needed
+    size_t format_uint(char* out, uint32_t value) {
+        char digits[10];
+        size_t n = 0;
+        do {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = digits[n - 1 - i];
+        }
+        return n;
+    }
+
+    bool write_file(const char* path, const void* data, size_t size) {
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            return false;
+        }
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t written = write(fd, bytes, size);
+            if (written <= 0) {
+                close(fd);
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+        close(fd);
+        return true;
+    }
+}
+
+FlightRecorder::FlightRecorder(const std::string& path_base, const std::string& crash_path_base)
+        : ticks_written(0), keyframes_written(0), frames_written(0)
+{
+    copy_path(replay_path, sizeof(replay_path), path_base + ".replay");
+    copy_path(frames_path, sizeof(frames_path), path_base + ".frames");
+    copy_path(crash_replay_path, sizeof(crash_replay_path), crash_path_base + ".replay");
+    copy_path(crash_frames_path, sizeof(crash_frames_path), crash_path_base + ".frames");
+}
+
+FlightRecorder::~FlightRecorder() {
+    if (installed == this) {
+        for (int signal_number : CRASH_SIGNALS) {
+            signal(signal_number, SIG_DFL);
+        }
+        installed = nullptr;
+    }
+}
+
+void FlightRecorder::install_crash_handler() {
+    installed = this;
+    install_alt_stack();
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = &FlightRecorder::crash_handler;
+    action.sa_flags = SA_ONSTACK | SA_RESETHAND; // A second crash inside the handler goes straight to the default
+    sigemptyset(&action.sa_mask);
+    for (int signal_number : CRASH_SIGNALS) {
+        sigaction(signal_number, &action, nullptr);
+    }
+}
+
+void FlightRecorder::install_alt_stack() {
+    if (alt_stack.memory) {
+        return;
+    }
+    alt_stack.memory.reset(new char[CRASH_HANDLER_STACK_SIZE]);
+
+    stack_t stack;
+    stack.ss_sp = alt_stack.memory.get();
+    stack.ss_size = CRASH_HANDLER_STACK_SIZE;
+    stack.ss_flags = 0;
+    sigaltstack(&stack, nullptr);
+}
+
+void FlightRecorder::crash_handler(int signal_number) {
+    if (installed != nullptr) {
+        installed->dump_to(installed->crash_replay_path, installed->crash_frames_path);
+    }
+
+    // The handler was reset on entry, so this crashes the way it would have without it
+    raise(signal_number);
+}
+
+void FlightRecorder::begin_tick(const Simulation& simulation) {
+    using namespace FlightRecorderUtil;
+
+    uint32_t tick_slot = ticks_written.load(std::memory_order_relaxed);
+    uint32_t tick = this->tick.load(std::memory_order_relaxed);
+    current = &ticks[tick_slot & (TICK_SLOTS - 1)];
+    current->tick = tick;
+    current->keyframe = NO_KEYFRAME;
+    current->num_inputs = 0;
+
+    if (tick % KEYFRAME_INTERVAL == 0 || keyframe_forced) {
+        keyframe_forced = false;
+
+        uint32_t keyframe_slot = keyframes_written.load(std::memory_order_relaxed);
+        KeyframeEntry& keyframe = keyframes[keyframe_slot % KEYFRAME_SLOTS];
+        keyframe.tick = tick;
+        keyframe.state = simulation.save_state();
+        keyframes_written.store(keyframe_slot + 1, std::memory_order_release);
+
+        current->keyframe = keyframe_slot;
+    }
+}
+
+void FlightRecorder::record_input(SimulationUtil::Input input) {
+    if (current != nullptr && current->num_inputs < FlightRecorderUtil::MAX_TICK_INPUTS) {
+        current->inputs[current->num_inputs++] = static_cast<uint8_t>(input);
+    }
+}
+
+void FlightRecorder::end_tick() {
+    current = nullptr;
+    tick.store(tick.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    ticks_written.store(ticks_written.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void FlightRecorder::record_frame(double frame_seconds) {
+    uint32_t frame_slot = frames_written.load(std::memory_order_relaxed);
+    FlightRecorderUtil::FrameEntry& frame = frames[frame_slot & (FlightRecorderUtil::FRAME_SLOTS - 1)];
+    frame.tick = tick.load(std::memory_order_relaxed);
+    frame.frame_us = static_cast<uint32_t>(frame_seconds * 1000000.0);
+    frames_written.store(frame_slot + 1, std::memory_order_release);
+}
+
+bool FlightRecorder::dump_to(const char* replay_dump_path, const char* frames_dump_path) {
+    size_t replay_size = build_replay_dump();
+    bool written = replay_size != 0 && write_file(replay_dump_path, dump_buffer, replay_size);
+
+    size_t frames_size = build_frame_dump();
+    written &= write_file(frames_dump_path, frame_dump_buffer, frames_size);
+
+    return written;
+}
+
+size_t FlightRecorder::build_replay_dump() {
+    using namespace FlightRecorderUtil;
+
+    uint32_t end = ticks_written.load(std::memory_order_acquire);
+    uint32_t keyframes_end = keyframes_written.load(std::memory_order_acquire);
+    // The oldest slot may already be getting overwritten by the tick in progress
+    uint32_t begin = (end >= TICK_SLOTS) ? end - TICK_SLOTS + 1 : 0;
+
+    // A keyframe is still usable if its slot has not been reused since
+    auto keyframe_valid = [&](uint32_t keyframe_slot) {
+        return keyframe_slot != NO_KEYFRAME && keyframe_slot < keyframes_end &&
+               keyframe_slot + KEYFRAME_SLOTS > keyframes_end;
+    };
+
+    // Playback has to start from a keyframe
+    while (begin < end && !keyframe_valid(ticks[begin & (TICK_SLOTS - 1)].keyframe)) {
+        ++begin;
+    }
+    if (begin == end) {
+        return 0;
+    }
+    uint32_t first_tick = ticks[begin & (TICK_SLOTS - 1)].tick;
+
+    size_t size = 0;
+    auto put = [&](const void* data, size_t length) {
+        std::memcpy(dump_buffer + size, data, length);
+        size += length;
+    };
+
+    // Ticks are counted from the start of the dump, and the keyframe interval covers all of them,
+    // so the index only needs the first keyframe. Later keyframes are loaded inline while playing.
+    ReplayUtil::Header header;
+    std::memcpy(header.magic, ReplayUtil::HEADER_MAGIC, sizeof(header.magic));
+    header.version = ReplayUtil::VERSION;
+    header.keyframe_interval = (end - begin) + 1;
+    header.state_size = sizeof(SimulationUtil::State);
+    put(&header, sizeof(header));
+
+    uint64_t first_keyframe_offset = size;
+    for (uint32_t i = begin; i < end; ++i) {
+        const TickEntry& entry = ticks[i & (TICK_SLOTS - 1)];
+        uint32_t dump_tick = entry.tick - first_tick;
+
+        if (keyframe_valid(entry.keyframe)) {
+            const KeyframeEntry& keyframe = keyframes[entry.keyframe % KEYFRAME_SLOTS];
+            uint8_t type = ReplayUtil::RECORD_KEYFRAME;
+            put(&type, sizeof(type));
+            put(&dump_tick, sizeof(dump_tick));
+            put(&keyframe.state, sizeof(keyframe.state));
+        }
+
+        uint8_t type = ReplayUtil::RECORD_TICK;
+        put(&type, sizeof(type));
+        put(&entry.num_inputs, sizeof(entry.num_inputs));
+        put(entry.inputs, entry.num_inputs);
+    }
+
+    ReplayUtil::Trailer trailer;
+    trailer.index_offset = size;
+    trailer.index_count = 1;
+    trailer.num_ticks = end - begin;
+    std::memcpy(trailer.magic, ReplayUtil::TRAILER_MAGIC, sizeof(trailer.magic));
+    trailer.padding = 0;
+    put(&first_keyframe_offset, sizeof(first_keyframe_offset));
+    put(&trailer, sizeof(trailer));
+
+    return size;
+}
+
+size_t FlightRecorder::build_frame_dump() {
+    using namespace FlightRecorderUtil;
+
+    uint32_t end = frames_written.load(std::memory_order_acquire);
+    uint32_t begin = (end >= FRAME_SLOTS) ? end - FRAME_SLOTS + 1 : 0;
+
+    static const char heading[] = "# tick frame_us\n";
+    size_t size = sizeof(heading) - 1;
+    std::memcpy(frame_dump_buffer, heading, size);
+
+    for (uint32_t i = begin; i < end; ++i) {
+        const FrameEntry& frame = frames[i & (FRAME_SLOTS - 1)];
+        size += format_uint(frame_dump_buffer + size, frame.tick);
+        frame_dump_buffer[size++] = ' ';
+        size += format_uint(frame_dump_buffer + size, frame.frame_us);
+        frame_dump_buffer[size++] = '\n';
+    }
+    return size;
+}
@@ -0,0 +1,108 @@
+#ifndef INC_3D_TETRIS_FLIGHTRECORDER_H
+#define INC_3D_TETRIS_FLIGHTRECORDER_H
+
+#include "Simulation.h"
+#include "Replay.h"
+#include "Util/NonCopyable.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace FlightRecorderUtil {
+    static constexpr uint32_t TICK_SLOTS      = 512; // About eight and a half seconds at 60 ticks a second
+    static constexpr uint32_t FRAME_SLOTS     = 512;
+    static constexpr uint32_t KEYFRAME_SLOTS  = 16;
+    static constexpr uint32_t KEYFRAME_INTERVAL = 60; // Ticks, so the keyframes cover more than the tick ring
+    static constexpr uint32_t MAX_TICK_INPUTS = 32; // Inputs past this in one tick are not recorded
+
+    static constexpr uint32_t NO_KEYFRAME = 0xFFFFFFFF;
+
+    struct TickEntry {
+        uint32_t tick;
+        uint32_t keyframe; // Keyframe slot to load before the tick, or NO_KEYFRAME
+        uint8_t  num_inputs;
+        uint8_t  inputs[MAX_TICK_INPUTS];
+    };
+
+    struct KeyframeEntry {
+        uint32_t tick;
+        SimulationUtil::State state;
+    };
+
+    struct FrameEntry {
+        uint32_t tick;     // Last tick simulated before the frame
+        uint32_t frame_us; // Time since the previous frame
+    };
+
+    // A dump is a replay: a header, one keyframe and a tick record for every tick in the ring,
+    // plus any later keyframes inline, a one entry index and the trailer
+    static constexpr size_t MAX_DUMP_SIZE =
+            sizeof(ReplayUtil::Header) +
+            KEYFRAME_SLOTS * (1 + sizeof(uint32_t) + sizeof(SimulationUtil::State)) +
+            TICK_SLOTS * (2 + MAX_TICK_INPUTS) +
+            sizeof(uint64_t) + sizeof(ReplayUtil::Trailer);
+
+    // "tick frame_us\n" per frame, each number at most ten digits
+    static constexpr size_t MAX_FRAME_DUMP_SIZE = 64 + FRAME_SLOTS * 22;
+}
+
+// Keeps the last few seconds of play in fixed size rings, which can be written out as a replay
+// Recording never allocates, and dumping only uses async-signal-safe calls on preallocated buffers,
+// so it can run from inside a crash handler
+class FlightRecorder : public Util::NonCopyable {
+public:
+    // Dumps are written to <path_base>.replay, with frame timings in <path_base>.frames
+    FlightRecorder(const std::string& path_base, const std::string& crash_path_base);
+    ~FlightRecorder();
+
+    // Dumps to the crash paths when the process dies from a signal
+    // Only the calling thread gets a stack to run the handler on, so a stack overflow on
+    // any other thread is only caught once that thread has called install_alt_stack()
+    void install_crash_handler();
+    static void install_alt_stack(); // For the calling thread, called once at the start of each thread
+
+    // Called around every simulated tick
+    void begin_tick(const Simulation& simulation);
+    void record_input(SimulationUtil::Input input);
+    void end_tick();
+
+    // The next tick starts with a keyframe, for when the state changes outside of a tick
+    void force_keyframe() { keyframe_forced = true; }
+
+    void record_frame(double frame_seconds);
+
+    bool dump() { return dump_to(replay_path, frames_path); } // Returns false if nothing could be written
+private:
+    static void crash_handler(int signal_number);
+
+    bool dump_to(const char* replay_dump_path, const char* frames_dump_path);
+    size_t build_replay_dump();
+    size_t build_frame_dump();
+
+    FlightRecorderUtil::TickEntry ticks[FlightRecorderUtil::TICK_SLOTS];
+    FlightRecorderUtil::KeyframeEntry keyframes[FlightRecorderUtil::KEYFRAME_SLOTS];
+    FlightRecorderUtil::FrameEntry frames[FlightRecorderUtil::FRAME_SLOTS];
+
+    // Only entries below these counts are complete, so a dump mid-write skips the torn one
+    std::atomic<uint32_t> ticks_written;
+    std::atomic<uint32_t> keyframes_written;
+    std::atomic<uint32_t> frames_written;
+
+    std::atomic<uint32_t> tick{0}; // Read by record_frame() on the render thread
+    bool keyframe_forced = true; // The first tick always has one
+    FlightRecorderUtil::TickEntry* current = nullptr; // Tick being recorded
+
+    // Paths and output are prepared up front, since a crash handler cannot allocate
+    char replay_path[1024];
+    char frames_path[1024];
+    char crash_replay_path[1024];
+    char crash_frames_path[1024];
+    uint8_t dump_buffer[FlightRecorderUtil::MAX_DUMP_SIZE];
+    char frame_dump_buffer[FlightRecorderUtil::MAX_FRAME_DUMP_SIZE];
+
+    static FlightRecorder* installed;
+};
+
+
+#endif //INC_3D_TETRIS_FLIGHTRECORDER_H
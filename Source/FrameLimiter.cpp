@@ -0,0 +1,128 @@
+#include "FrameLimiter.h"
+#include "ViewComponent.h"
+#include "Constants.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+bool FrameLimiterUtil::parse_present_mode(const std::string& name, PresentMode& mode) {
+    if (name == "vsync") {
+        mode = PresentMode::VSYNC;
+    } else if (name == "adaptive") {
+        mode = PresentMode::ADAPTIVE;
+    } else if (name == "uncapped") {
+        mode = PresentMode::UNCAPPED;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* FrameLimiterUtil::present_mode_name(PresentMode mode) {
+    switch (mode) {
+        case PresentMode::VSYNC :
+            return "vsync";
+        case PresentMode::ADAPTIVE :
+            return "adaptive";
+        default:
+            return "uncapped";
+    }
+}
+
+void FrameLimiter::Accumulator::add(double ms) {
+    ++frames;
+    sum += ms;
+    sum_of_squares += ms * ms;
+    max = std::max(max, ms);
+}
+
+FrameLimiterUtil::FrameStats FrameLimiter::Accumulator::finish() const {
+    FrameLimiterUtil::FrameStats result = {frames, 0.0, 0.0, max};
+    if (frames != 0) {
+        result.mean_ms = sum / frames;
+        result.jitter_ms = std::sqrt(std::max(0.0, sum_of_squares / frames - result.mean_ms * result.mean_ms));
+    }
+    return result;
+}
+
+FrameLimiter::FrameLimiter(FrameLimiterUtil::PresentMode mode, double target_fps)
+        : mode(mode),
+          frame_length(mode == FrameLimiterUtil::PresentMode::UNCAPPED ?
+                       std::chrono::duration_cast<Clock::duration>(
+                               std::chrono::duration<double>(1.0 / (target_fps > 0.0 ? target_fps : FPS))) :
+                       Clock::duration::zero())
+{
+}
+
+void FrameLimiter::apply(ViewComponent& view_component) {
+    using FrameLimiterUtil::PresentMode;
+
+    switch (mode) {
+        case PresentMode::VSYNC :
+            view_component.set_swap_interval(1);
+            break;
+        case PresentMode::ADAPTIVE :
+            // A negative interval asks for late swaps to happen straight away
+            view_component.set_swap_interval(view_component.supports_adaptive_vsync() ? -1 : 1);
+            break;
+        case PresentMode::UNCAPPED :
+            view_component.set_swap_interval(0);
+            break;
+    }
+}
+
+void FrameLimiter::end_frame() {
+    Clock::time_point now = Clock::now();
+    if (!started) {
+        started = true;
+        last_frame = interval_start = now;
+        next_frame = now + frame_length;
+        return;
+    }
+
+    if (frame_length != Clock::duration::zero()) {
+        // Catching up on frames which were missed would only make the next few run back to back
+        if (now > next_frame + frame_length) {
+            next_frame = now;
+        }
+        wait_until(next_frame);
+        next_frame += frame_length;
+        now = Clock::now();
+    }
+
+    double frame_ms = std::chrono::duration<double, std::milli>(now - last_frame).count();
+    last_frame = now;
+    interval.add(frame_ms);
+    total.add(frame_ms);
+
+    if (std::chrono::duration<double>(now - interval_start).count() >= FrameLimiterUtil::STATS_INTERVAL) {
+        stats = interval.finish();
+        interval = Accumulator();
+        interval_start = now;
+    }
+}
+
+const FrameLimiterUtil::FrameStats& FrameLimiter::get_total_stats() {
+    total_stats = total.finish();
+    return total_stats;
+}
+
+void FrameLimiter::wait_until(Clock::time_point deadline) {
+    // Sleep for most of the wait, since the scheduler can not be trusted to wake up on time
+    Clock::time_point sleep_until = deadline - std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(spin_seconds));
+    Clock::time_point now = Clock::now();
+    if (now < sleep_until) {
+        std::this_thread::sleep_until(sleep_until);
+
+        // Track how late sleeps wake up, so the spin covers it next time
+        double oversleep = std::chrono::duration<double>(Clock::now() - sleep_until).count();
+        spin_seconds = std::max(FrameLimiterUtil::MIN_SPIN_SECONDS, spin_seconds * 0.9 + oversleep * 1.5 * 0.1);
+    }
+
+    // Then spin for the rest, letting anything else which is ready run in the meantime
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef INC_3D_TETRIS_FRAMELIMITER_H
+#define INC_3D_TETRIS_FRAMELIMITER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+class ViewComponent;
+
+namespace FrameLimiterUtil {
+    enum class PresentMode {
+        VSYNC,    // Swap waits for the display
+        ADAPTIVE, // Like VSYNC, but late frames tear instead of waiting a whole refresh. VSYNC where unsupported
+        UNCAPPED, // Swap never waits, frames are paced to the target FPS instead
+    };
+
+    // Sleeping stops this long before a frame is due, and the rest is spun
+    // Grows to cover however late sleeps have actually been waking up
+    static constexpr double MIN_SPIN_SECONDS = 0.0005;
+
+    static constexpr double STATS_INTERVAL = 1.0; // Seconds the frame stats are gathered over
+
+    struct FrameStats {
+        uint32_t frames;
+        double mean_ms;
+        double jitter_ms; // Standard deviation of the frame time
+        double max_ms;
+    };
+
+    bool parse_present_mode(const std::string& name, PresentMode& mode); // Returns false for an unknown name
+    const char* present_mode_name(PresentMode mode);
+}
+
+// Paces the render loop, so it never redraws faster than it can be shown
+class FrameLimiter {
+public:
+    // UNCAPPED paces to FPS when no target FPS above zero is given, since running flat out only burns a core
+    FrameLimiter(FrameLimiterUtil::PresentMode mode, double target_fps);
+
+    // Sets the swap interval for the mode, needs the window's context to be current
+    void apply(ViewComponent& view_component);
+
+    // Called after every swap, waits until the next frame is due in UNCAPPED
+    void end_frame();
+    void reset() { started = false; } // The next frame starts afresh, for after a gap in drawing
+
+    // Getters
+    FrameLimiterUtil::PresentMode get_mode() const { return mode; }
+    const FrameLimiterUtil::FrameStats& get_stats() const { return stats; } // Over the last full interval
+    const FrameLimiterUtil::FrameStats& get_total_stats(); // Over every frame so far
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Accumulator {
+        uint32_t frames = 0;
+        double sum = 0.0;
+        double sum_of_squares = 0.0;
+        double max = 0.0;
+
+        void add(double ms);
+        FrameLimiterUtil::FrameStats finish() const;
+    };
+
+    void wait_until(Clock::time_point deadline);
+
+    FrameLimiterUtil::PresentMode mode;
+    Clock::duration frame_length; // Zero when not pacing
+
+    Clock::time_point next_frame;
+    Clock::time_point last_frame;
+    Clock::time_point interval_start;
+    bool started = false;
+    double spin_seconds = FrameLimiterUtil::MIN_SPIN_SECONDS * 2;
+
+    Accumulator interval;
+    Accumulator total;
+    FrameLimiterUtil::FrameStats stats = {0, 0.0, 0.0, 0.0};
+    FrameLimiterUtil::FrameStats total_stats = {0, 0.0, 0.0, 0.0};
+};
+
+
+#endif //INC_3D_TETRIS_FRAMELIMITER_H
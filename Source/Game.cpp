@@ -6,13 +6,19 @@
 
 #include "Util/Filesystem.h"
 
-#include <set>
-#include <vector>
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
-#ifndef NDEBUG
+#include <cstdio>
+#include <fstream>
 #include <iostream>
-#endif
 
 Game::Game() :
         view_component(FileSystem::getPath("Shaders/vertex.vert"),
@@ -31,201 +37,791 @@ Game::Game() :
                                 {SoundUtil::SFXSound::MOVE, FileSystem::getPath("Resources/SFX/Move.wav")},
                         },
                         this),
+        flight_recorder(FileSystem::getPath("flight"), FileSystem::getPath("crash")),
+        save_path(FileSystem::getPath("session.sav"))
+{
+    try {
+        high_scores.reset(new HighScoreTable(FileSystem::getPath("highscores.log"),
+                                             FileSystem::getPath("highscores.idx")));
+        best_score = high_scores->get_best_score();
+    } catch (std::runtime_error& e) {
+        // A broken shared leaderboard should not stop anyone playing
+#ifndef NDEBUG
+        std::cerr << e.what() << "\n";
+#endif
+        high_scores.reset();
+    }
+    flight_recorder.install_crash_handler();
+}
 
-        current_tetromino(static_cast<TetrominoUtil::TetrominoType>(rng_component.rng(0, 6)), this),
-        ghost_tetromino(current_tetromino)
+void Game::attach_bot_bridge(const std::string& shm_name) {
+    bot_bridge.reset(new BotBridge(shm_name));
+    publish_bot_snapshot();
+}
 
-{
-    previous_tetromino_move_time = glfwGetTime();
+void Game::attach_bot_plugin(const std::string& library_path, double time_limit) {
+    bot_plugin.reset(new BotPluginHost(library_path, time_limit));
+    bot_move_pending = true;
+}
+
+void Game::start_recording(const std::string& replay_path) {
+    replay_writer.reset(new ReplayWriter(replay_path, REPLAY_KEYFRAME_INTERVAL));
+}
+
+void Game::start_playback(const std::string& replay_path) {
+    replay_reader.reset(new ReplayReader(replay_path));
+    replay_reader->seek(simulation, 0);
+    simulation.consume_events();
+}
+
+bool Game::resume_saved_game() {
+    SimulationUtil::State state;
+    if (!SaveFile::load(save_path, state) || state.game_over) {
+        return false;
+    }
+
+    simulation.load_state(state);
+    paused = true; // Give the player a moment before the game carries on
+
+    // The state jumped without a tick
+    if (replay_writer) {
+        replay_writer->force_keyframe();
+    }
+    flight_recorder.force_keyframe();
+    publish_bot_snapshot();
+    bot_move_pending = true;
+
+    return true;
+}
+
+void Game::start_versus(unsigned int player, uint16_t local_port, const std::string& remote_host,
+                        uint16_t remote_port, double latency_seconds, double loss_fraction) {
+    versus.reset(new VersusSession(player, local_port, remote_host, remote_port));
+    versus->set_conditions(latency_seconds, loss_fraction);
+}
+
+void Game::start_broadcast(uint16_t port) {
+    spectator_server.reset(new SpectatorServer(port));
+}
+
+void Game::start_spectating(const std::string& host, uint16_t port) {
+    spectator_client.reset(new SpectatorClient(host, port));
+}
+
+void Game::set_auto_shift(double das_seconds, double arr_seconds) {
+    auto_shift = AutoShift(das_seconds, arr_seconds);
+}
+
+void Game::set_present_mode(FrameLimiterUtil::PresentMode mode, double target_fps, bool show_stats) {
+    frame_limiter = FrameLimiter(mode, target_fps);
+    show_frame_stats = show_stats;
+}
+
+void Game::measure_latency(const std::string& dump_path) {
+    latency_path = dump_path;
 }
 
 void Game::begin() {
+    // The game runs on its own thread, so a slow swap never holds up input or gravity
+    publish_render_snapshot();
+    std::thread simulation_thread(&Game::simulation_loop, this);
+
+    frame_limiter.apply(view_component);
+
+    double previous_frame_time = glfwGetTime();
+    double next_idle_frame = previous_frame_time;
+    while (!close_game) {
+        const RenderUtil::Snapshot& snapshot = render_snapshots.latest();
+
+        if (snapshot.rotation != RenderUtil::ROTATION_NONE) {
+            // Paused or game over, so nothing moves but the view
+            // Sleep in the event queue and draw at a lower rate, the simulation thread wakes us when that changes
+            double wait = next_idle_frame - glfwGetTime();
+            if (wait > 0.0) {
+                glfwWaitEventsTimeout(wait);
+                if (view_component.should_window_close()) {
+                    close_game = true;
+                }
+                continue;
+            }
+            next_idle_frame = glfwGetTime() + 1.0 / IDLE_FPS;
+            frame_limiter.reset(); // Idle frames would only skew the frame stats
+        }
+
+        // Poll events for controls, they are picked up by the simulation thread
+        glfwPollEvents();
+        if (view_component.should_window_close()) {
+            close_game = true;
+        }
+
+        double frame_time = glfwGetTime();
+        float tick_progress = static_cast<float>((frame_time - snapshot.tick_time) * FPS);
+        tick_progress = std::min(std::max(tick_progress, 0.0f), 1.0f);
+        render(snapshot, static_cast<float>(frame_time - previous_frame_time), tick_progress);
+        double drawn_time = glfwGetTime();
+        view_component.swap_buffers();
+        record_latency(snapshot, drawn_time, glfwGetTime());
+        if (snapshot.rotation == RenderUtil::ROTATION_NONE) {
+            frame_limiter.end_frame();
+        }
+
+        flight_recorder.record_frame(frame_time - previous_frame_time);
+        previous_frame_time = frame_time;
+    }
+
+    simulation_thread.join();
+
+    if (show_frame_stats) {
+        const FrameLimiterUtil::FrameStats& stats = frame_limiter.get_total_stats();
+        std::cout << FrameLimiterUtil::present_mode_name(frame_limiter.get_mode()) << ": " << stats.frames
+                  << " frames, mean " << stats.mean_ms << "ms, jitter " << stats.jitter_ms << "ms, max "
+                  << stats.max_ms << "ms\n";
+    }
+    if (!latency_path.empty()) {
+        dump_latency();
+    }
+}
+
+void Game::benchmark(const std::string& replay_path, uint32_t frames) {
+    // Everything runs on this thread, one tick and one frame at a time with a fixed frame length,
+    // each drawn as its tick ends, so every run draws exactly the same frames however fast it goes
+    // The clock is only read to time the frames
+    start_playback(replay_path);
+    view_component.set_swap_interval(0);
+
+    std::vector<double> frame_ms;
+    frame_ms.reserve(frames);
+    uint64_t draw_calls = 0;
+    uint64_t buffer_uploads = 0;
+    uint64_t state_changes = 0;
+    uint64_t redundant_state_changes = 0;
+
+    double start_time = glfwGetTime();
+    double previous_frame_time = start_time;
+    while (frame_ms.size() < frames && !close_game) {
+        glfwPollEvents();
+        if (view_component.should_window_close()) {
+            close_game = true;
+        }
+
+        tick_deadline = glfwGetTime(); // Only decides which input events are taken, and a replay takes none
+        update();
+        publish_render_snapshot();
+
+        view_component.reset_counters();
+        render(render_snapshots.latest(), 1.0f / FPS, 1.0f);
+        view_component.swap_buffers();
+        ViewComponentUtil::RenderCounters counters = view_component.get_counters();
+        draw_calls += counters.draw_calls;
+        buffer_uploads += counters.buffer_uploads;
+        state_changes += counters.state_changes;
+        redundant_state_changes += counters.redundant_state_changes;
+
+        double frame_time = glfwGetTime();
+        frame_ms.push_back((frame_time - previous_frame_time) * 1000.0);
+        previous_frame_time = frame_time;
+    }
+    if (frame_ms.empty()) {
+        return;
+    }
+
+    double total_ms = (previous_frame_time - start_time) * 1000.0;
+    size_t count = frame_ms.size();
+    std::sort(frame_ms.begin(), frame_ms.end());
+    auto percentile = [&](double fraction) {
+        return frame_ms[std::min(count - 1, static_cast<size_t>(std::ceil(fraction * count)) - 1)];
+    };
+
+    std::cout << "Renderer: " << view_component.get_renderer_name() << "\n"
+              << "Frames: " << count << " in " << total_ms / 1000.0 << "s\n"
+              << "Frame time: mean " << total_ms / count << "ms, p50 " << percentile(0.5) << "ms, p99 "
+              << percentile(0.99) << "ms, max " << frame_ms.back() << "ms\n"
+              << "Per frame: " << static_cast<double>(draw_calls) / count << " draw calls, "
+              << static_cast<double>(buffer_uploads) / count << " buffer uploads, "
+              << static_cast<double>(state_changes) / count << " state changes ("
+              << static_cast<double>(redundant_state_changes) / count << " redundant ones skipped)\n";
+}
+
+void Game::record_latency(const RenderUtil::Snapshot& snapshot, double drawn_time, double swapped_time) {
+    if (snapshot.input_sequence == latency_drawn_sequence.load(std::memory_order_relaxed)) {
+        return; // Nothing new to measure in this frame
+    }
+    input_to_draw.add((drawn_time - snapshot.input_time) * 1000.0);
+    input_to_swap.add((swapped_time - snapshot.input_time) * 1000.0);
+    latency_drawn_sequence.store(snapshot.input_sequence, std::memory_order_release);
+}
+
+void Game::dump_latency() const {
+    std::ofstream out(latency_path);
+    if (!out) {
+        std::cerr << "Failed to write input latency to " << latency_path << "\n";
+        return;
+    }
+    input_to_draw.write(out, "draw");
+    input_to_swap.write(out, "swap");
+
+    std::cout << "Input to swap: " << input_to_swap.get_count() << " inputs, mean " << input_to_swap.get_mean_ms()
+              << "ms, p99 " << input_to_swap.get_percentile_ms(99.0) << "ms\n";
+}
+
+void Game::simulation_loop() {
     static double limit_FPS = 1.0 / FPS;
 
+    // The crash handler needs a stack on this thread too, or an overflow here dies without a dump
+    FlightRecorder::install_alt_stack();
+
     // Game loop
-    double previous_time = glfwGetTime(), timer = previous_time;
+    double previous_time = glfwGetTime();
     double delta_time = 0, now_time = 0;
-    int frames       = 0, updates = 0;
     while (!close_game) {
         // Handle delta time
         now_time = glfwGetTime();
         delta_time += (now_time - previous_time) / limit_FPS;
         previous_time = now_time;
 
-        // Poll events for controls
-        glfwPollEvents();
+        // Don't try to catch up on a long stall, it would only make the next frame slower still
+        if (delta_time > MAX_CATCH_UP_TICKS) {
+            delta_time = MAX_CATCH_UP_TICKS;
+        }
+        while (delta_time >= 1.0 && !close_game) {
+            // Each tick only takes the input received before it was due, later input waits for its own tick
+            tick_deadline = now_time - (delta_time - 1.0) * limit_FPS;
+            update();
+            --delta_time;
+        }
 
-        // If game is in game over state or paused
-        // game should not be updated
-        if (!game_over && !paused) {
-            // Update game at FPS
-            while (delta_time >= 1.0) {
-                if (!game_over) {
-                    tick();
-                }
+        last_tick_time = now_time - delta_time * limit_FPS;
+        publish_render_snapshot();
 
-                ++updates;
-                --delta_time;
-            }
+        // Play music
+        if (!is_game_finished()) {
+            sound_component.play_music();
         } else {
-            while (delta_time >= 1.0) {
-                window_control();
-
-                ++updates;
-                --delta_time;
-            }
+            sound_component.play_game_over_music();
         }
 
+        // Nothing to do until the next tick is due
+        std::this_thread::sleep_for(std::chrono::duration<double>((1.0 - delta_time) * limit_FPS));
+    }
 
-        // Rendering
-        // ---------
+    save_game();
+}
 
-        // Rotate scene
-        if (game_over) {
-            view_component.rotate_view_right();
-        } else if (paused) {
-            view_component.rotate_view_left();
-        } else {
-            view_component.reset_view_rotation();
-        }
+void Game::update() {
+    pose_before_tick = active_simulation().get_current_tetromino().get_pose();
+
+    // If game is in game over state or paused
+    // game should not be updated
+    if (replay_reader) {
+        // Replays keep being played through game overs, since they can be seeked
+        playback_tick();
+    } else if (spectator_client) {
+        spectate_tick();
+    } else if (versus) {
+        // Versus can not be paused, and keeps running after the game so the peer can finish too
+        versus_tick();
+    } else if (!simulation.is_game_over() && !paused) {
+        tick();
+    } else {
+        window_control();
+        broadcast(); // Spectators joining now still need to see the game
+    }
+    ++simulation_ticks;
+}
 
-        // Draw tetrominos
-        view_component.clear_screen();
-        if (current_tetromino.get_state() != TetrominoUtil::TetrominoState::LANDED) {
-            view_component.draw_tetromino(current_tetromino, false);
+void Game::publish_render_snapshot() {
+    using RenderUtil::add_message;
+
+    RenderUtil::Snapshot& snapshot = render_snapshots.back();
+    const Simulation& shown = active_simulation();
+    bool finished = is_game_finished();
+
+    snapshot.tick = simulation_ticks;
+    snapshot.tick_time = last_tick_time;
+    snapshot.input_sequence = latency_sequence;
+    snapshot.input_time = latency_input_time;
+    std::memcpy(snapshot.cells, shown.get_board().data(), Board::size_in_bytes());
+    const Tetromino& current_tetromino = shown.get_current_tetromino();
+    snapshot.draw_current = current_tetromino.get_state() != TetrominoUtil::TetrominoState::LANDED;
+    snapshot.current = current_tetromino.get_pose();
+    snapshot.previous = pose_before_tick;
+    snapshot.ghost = shown.get_ghost_tetromino().get_pose();
+
+    // Rotate scene
+    if (finished) {
+        snapshot.rotation = RenderUtil::ROTATION_RIGHT;
+    } else if (paused) {
+        snapshot.rotation = RenderUtil::ROTATION_LEFT;
+    } else {
+        snapshot.rotation = RenderUtil::ROTATION_NONE;
+    }
 
-            // Draw ghost indicator tetromino
-            ghost_tetromino = current_tetromino;
-            ghost_tetromino.jump_down(true);
-            view_component.draw_tetromino(ghost_tetromino, true);
+    // Display text
+    snapshot.num_messages = 0;
+    add_message(snapshot, 10, SCREEN_HEIGHT - 40, 0.65f, "Score: " + std::to_string(shown.get_score()));
+    if (versus) {
+        const Simulation& opponent = versus->get_remote_simulation();
+        add_message(snapshot, 10, SCREEN_HEIGHT - 70, 0.45f,
+                    "Opponent: " + std::to_string(opponent.get_score()) + "  " +
+                    std::to_string(opponent.get_lines_cleared()) + " lines");
+        add_message(snapshot, 10, 15, 0.45f,
+                    "Rollbacks: " + std::to_string(versus->get_num_rollbacks()) +
+                    "  Ahead: " + std::to_string(versus->get_ticks_ahead()) + " ticks");
+    } else if (!spectator_client) {
+        add_message(snapshot, 10, SCREEN_HEIGHT - 70, 0.45f,
+                    "Best: " + std::to_string(std::max(best_score, shown.get_score())));
+    }
+    if (replay_reader) {
+        add_message(snapshot, 10, 15, 0.45f,
+                    "Replay " + std::to_string(replay_reader->get_current_tick() / FPS) + "s / " +
+                    std::to_string(replay_reader->get_num_ticks() / FPS) + "s" +
+                    "   Left/Right: Seek   P: Pause");
+    }
+    if (bot_plugin) {
+        if (bot_plugin->is_disabled()) {
+            add_message(snapshot, 10, 40, 0.45f, "Bot disabled, it kept going over the time limit");
+        } else {
+            add_message(snapshot, 10, 40, 0.45f,
+                        "Bot " + std::to_string(static_cast<int>(bot_plugin->mean_call_time() * 1e6)) + "us mean  " +
+                        std::to_string(static_cast<int>(bot_plugin->max_call_time() * 1e6)) + "us max  " +
+                        std::to_string(bot_plugin->num_overruns()) + " of " +
+                        std::to_string(bot_plugin->num_calls()) + " calls late");
         }
-        for (auto& t : landed) {
-            view_component.draw_tetromino(t, false);
+    }
+    if (spectator_client) {
+        add_message(snapshot, 10, 15, 0.45f,
+                    "Spectating  " + std::to_string(static_cast<int>(spectator_client->get_bytes_per_second())) +
+                    " B/s  decode " +
+                    std::to_string(static_cast<int>(spectator_client->get_decode_microseconds() * 1000.0)) + "ns");
+    }
+    if (spectator_client && !spectator_client->is_connected()) {
+        add_message(snapshot, 35, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2) + 60, 1.0f, "Stream ended");
+    } else if (versus && !versus->is_connected()) {
+        add_message(snapshot, 35, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2) + 60, 1.0f, "Waiting for opponent");
+    } else if (versus && finished) {
+        bool lost = versus->get_local_simulation().is_game_over();
+        bool draw = lost && versus->get_remote_simulation().is_game_over();
+        add_message(snapshot, 50, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2) + 60, 1.5f,
+                    draw ? "Draw" : (versus->did_local_win() ? "You Win" : "You Lose"));
+        add_message(snapshot, 35, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2), 0.6f, "Press Esc to Quit");
+    } else if (finished) {
+        add_message(snapshot, 50, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2) + 60, 1.5f, "Game Over");
+        add_message(snapshot, 35, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2), 0.6f, "Press Esc to Quit or R to Reset");
+        if (high_score_rank >= 0) {
+            add_message(snapshot, 35, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2) - 40, 0.6f,
+                        "New high score! Rank " + std::to_string(high_score_rank + 1));
         }
+    } else if (paused) {
+        add_message(snapshot, 35, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2) + 60, 1.3f, "Game Paused");
+        add_message(snapshot, 105, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2), 0.6f, "Press P to unpause");
+    }
 
-        // Draw the border
-        view_component.draw_border();
-
-        // Display text
-        view_component.draw_message(glm::ivec2{10, SCREEN_HEIGHT - 40},
-                                    0.65f, "Score: " + std::to_string(score));
-        if (game_over) {
-            view_component.draw_message(glm::ivec2{50, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2) + 60},
-                                        1.5f, "Game Over");
-            view_component.draw_message(glm::ivec2{35, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2)},
-                                        0.6f, "Press Esc to Quit or R to Reset");
-        } else if (paused) {
-            view_component.draw_message(glm::ivec2{35, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2) + 60},
-                                        1.3f, "Game Paused");
-            view_component.draw_message(glm::ivec2{105, SCREEN_HEIGHT - (SCREEN_HEIGHT / 2)},
-                                        0.6f, "Press P to unpause");
-        }
+    render_snapshots.publish();
 
-        ++frames;
+    // The render thread may be asleep waiting for events while idle
+    if (snapshot.rotation != published_rotation) {
+        published_rotation = snapshot.rotation;
+        glfwPostEmptyEvent();
+    }
+}
 
-        view_component.swap_buffers();
+void Game::render(const RenderUtil::Snapshot& snapshot, float frame_seconds, float tick_progress) {
+    // Rotate scene
+    if (snapshot.rotation == RenderUtil::ROTATION_RIGHT) {
+        view_component.rotate_view_right(frame_seconds);
+    } else if (snapshot.rotation == RenderUtil::ROTATION_LEFT) {
+        view_component.rotate_view_left(frame_seconds);
+    } else {
+        view_component.reset_view_rotation();
+    }
 
-        // Play music
-        if (!game_over) {
-            sound_component.play_music();
-        } else {
-            sound_component.play_game_over_music();
-        }
+    // Draw the landed stack and the border first, so the faded ghost blends over them
+    view_component.clear_screen();
+    Board board;
+    board.load(snapshot.cells);
+    view_component.draw_board(board);
+    view_component.draw_border();
+
+    // Draw tetrominos
+    // Nothing drawn needs a simulation, so they are not bound to one
+    if (snapshot.draw_current) {
+        glm::vec2 offset = interpolation_offset(snapshot, tick_progress);
+        view_component.draw_tetromino(Tetromino(snapshot.current, nullptr), false, offset);
+
+        // Draw ghost indicator tetromino
+        // It only follows sideways, since it jumps up and down with whatever is below it
+        view_component.draw_tetromino(Tetromino(snapshot.ghost, nullptr), true, glm::vec2{offset.x, 0.0f});
+    }
+
+    // Display text
+    for (uint8_t i = 0; i < snapshot.num_messages; ++i) {
+        const RenderUtil::Message& message = snapshot.messages[i];
+        view_component.draw_message(glm::ivec2{message.x, message.y}, message.scale, message.text);
+    }
+
+    // Frame stats belong to the render thread, so they are not part of the snapshot
+    if (show_frame_stats) {
+        const FrameLimiterUtil::FrameStats& stats = frame_limiter.get_stats();
+        char text[RenderUtil::MAX_MESSAGE_LENGTH];
+        std::snprintf(text, sizeof(text), "%s %.2fms jitter %.2fms",
+                      FrameLimiterUtil::present_mode_name(frame_limiter.get_mode()), stats.mean_ms, stats.jitter_ms);
+        view_component.draw_message(glm::ivec2{10, SCREEN_HEIGHT - 100}, 0.45f, text);
+    }
+    if (!latency_path.empty()) {
+        char text[RenderUtil::MAX_MESSAGE_LENGTH];
+        std::snprintf(text, sizeof(text), "input to swap p50 %.1fms p99 %.1fms",
+                      input_to_swap.get_percentile_ms(50.0), input_to_swap.get_percentile_ms(99.0));
+        view_component.draw_message(glm::ivec2{10, SCREEN_HEIGHT - 125}, 0.45f, text);
     }
 }
 
 void Game::reset() {
-    game_over = false;
-    close_game = false;
+    // Both players would have to agree to a new game, and spectators only watch
+    if (versus || spectator_client) {
+        return;
+    }
+
+    // Resetting a replay rewinds it
+    if (replay_reader) {
+        replay_reader->seek(simulation, 0);
+        simulation.consume_events();
+        return;
+    }
+
     paused = false;
-    score = 0;
+    auto_shift.reset();
 
-    landed.clear();
-    current_tetromino = Tetromino(static_cast<TetrominoUtil::TetrominoType>(rng_component.rng(0, 6)), this);
-    ghost_tetromino = current_tetromino;
-    previous_tetromino_move_time = glfwGetTime();
+    simulation.reset();
+    handle_simulation_events();
+    high_score_rank = -1;
 
-    view_component.reset_view_rotation();
+    // The state jumped without a tick, so the replay needs a fresh keyframe
+    if (replay_writer) {
+        replay_writer->force_keyframe();
+    }
+    flight_recorder.force_keyframe();
+}
+
+glm::vec2 Game::interpolation_offset(const RenderUtil::Snapshot& snapshot, float tick_progress) const {
+    const TetrominoUtil::Pose& previous = snapshot.previous;
+    const TetrominoUtil::Pose& current = snapshot.current;
+
+    // Only a tetromino shifted by a cell is moved smoothly, anything else like a rotation,
+    // a new tetromino or a hard drop shows up straight away
+    int dx = previous.top_left[0] - current.top_left[0];
+    int dy = previous.top_left[1] - current.top_left[1];
+    if (previous.type != current.type || previous.rotation_state != current.rotation_state ||
+        std::abs(dx) > 1 || std::abs(dy) > 1) {
+        return glm::vec2(0.0f);
+    }
+
+    // The tetromino is drawn one tick behind, moving from where it was towards where it is now
+    return glm::vec2{dx, dy} * (1.0f - tick_progress);
 }
 
 void Game::tick() {
-    if (current_tetromino.get_state() == TetrominoUtil::TetrominoState::LANDED) {
-        current_tetromino =
-                Tetromino(static_cast<TetrominoUtil::TetrominoType>(rng_component.rng(0, 6)), this);
+    flight_recorder.begin_tick(simulation);
+    if (replay_writer) {
+        replay_writer->begin_tick(simulation);
+    }
+
+    step();
+
+    if (replay_writer) {
+        replay_writer->end_tick();
+    }
+    flight_recorder.end_tick();
+
+    handle_simulation_events();
+    broadcast();
+}
+
+void Game::step() {
+    simulation.begin_tick();
+
+    // Ask the bot plugin where the new tetromino should go
+    if (bot_plugin && bot_move_pending) {
+        bot_move_pending = false;
+        if (!apply_bot_plugin_move()) {
+            return;
+        }
     }
 
     // Handle input
+    // Repeats from held keys go in between the key presses, in the order they came due
     int input_key;
     do {
         input_key = window_control();
+        if (!apply_auto_shift() || !handle_key(input_key)) {
+            return;
+        }
+    } while(input_key != GLFW_KEY_UNKNOWN);
+    auto_shift.advance(tick_deadline);
+    if (!apply_auto_shift()) {
+        return;
+    }
+
+    // Handle moves sent by an attached bot
+    if (bot_bridge) {
+        BotProtocol::Command command;
+        while (bot_bridge->fetch_command(command)) {
+            if (command == BotProtocol::NONE || command > BotProtocol::HARD_DROP) {
+                continue;
+            }
+
+            // Bot commands share their values with simulation inputs
+            if (!apply_input(static_cast<SimulationUtil::Input>(command))) {
+                return;
+            }
+        }
+    }
+
+    // Gravity
+    simulation.end_tick();
+}
+
+void Game::playback_tick() {
+    // Viewer controls
+    static constexpr uint32_t SEEK_TICKS = 5 * FPS;
+
+    int input_key;
+    while ((input_key = window_control()) != GLFW_KEY_UNKNOWN) {
+        uint32_t current = replay_reader->get_current_tick();
         switch (input_key) {
             case GLFW_KEY_LEFT :
-                current_tetromino.translate_left();
-                sound_component.play_sfx(SoundUtil::SFXSound::MOVE);
-#ifndef NDEBUG
-                std::cerr << "Input: Left\n";
-#endif
+                replay_reader->seek(simulation, current > SEEK_TICKS ? current - SEEK_TICKS : 0);
+                simulation.consume_events(); // Don't play sounds for the skipped ticks
                 break;
             case GLFW_KEY_RIGHT :
-                current_tetromino.translate_right();
-                sound_component.play_sfx(SoundUtil::SFXSound::MOVE);
+                replay_reader->seek(simulation, current + SEEK_TICKS);
+                simulation.consume_events();
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!paused && !close_game) {
+        replay_reader->step(simulation);
+        handle_simulation_events();
+    }
+    broadcast();
+}
+
+void Game::versus_tick() {
+    int input_key;
+    do {
+        input_key = window_control();
+        apply_auto_shift();
+        if (!handle_key(input_key)) {
+            break;
+        }
+    } while (input_key != GLFW_KEY_UNKNOWN);
+    auto_shift.advance(tick_deadline);
+    apply_auto_shift();
+
+    versus->tick();
+    handle_simulation_events();
+    broadcast();
+}
+
+void Game::spectate_tick() {
+    // Only Escape means anything to a spectator
+    int input_key;
+    do {
+        input_key = window_control();
+    } while (input_key != GLFW_KEY_UNKNOWN && input_key != GLFW_KEY_ESCAPE);
+
+    spectator_client->poll();
+}
+
+void Game::broadcast() {
+    if (spectator_server) {
+        spectator_server->publish(active_simulation().save_state());
+    }
+}
+
+bool Game::handle_key(int key) {
+    switch (key) {
+        case GLFW_KEY_LEFT :
 #ifndef NDEBUG
-                std::cerr << "Input: Right\n";
+            std::cerr << "Input: Left\n";
 #endif
-                break;
-            case GLFW_KEY_UP :
-                current_tetromino.rotate_right();
-                sound_component.play_sfx(SoundUtil::SFXSound::MOVE);
+            return apply_input(SimulationUtil::Input::LEFT);
+        case GLFW_KEY_RIGHT :
 #ifndef NDEBUG
-                std::cerr << "Input: Up\n";
+            std::cerr << "Input: Right\n";
 #endif
-                break;
-            case GLFW_KEY_DOWN :
-                current_tetromino.translate_down(false);
-                sound_component.play_sfx(SoundUtil::SFXSound::MOVE);
-
-                // Reset move time
-                previous_tetromino_move_time = glfwGetTime();
+            return apply_input(SimulationUtil::Input::RIGHT);
+        case GLFW_KEY_UP :
 #ifndef NDEBUG
-                std::cerr << "Input: Down\n";
+            std::cerr << "Input: Up\n";
 #endif
-                break;
-            case GLFW_KEY_SPACE :
+            return apply_input(SimulationUtil::Input::ROTATE);
+        case GLFW_KEY_DOWN :
 #ifndef NDEBUG
-                std::cerr << "Input: Space\n";
+            std::cerr << "Input: Down\n";
 #endif
-                current_tetromino.jump_down(false);
-                sound_component.play_sfx(SoundUtil::SFXSound::MOVE);
-                return; // Exit function, because last translate down is redundant
-                break;  // Break statement is redundant, yet there for stylistic reasons
-            case GLFW_KEY_ESCAPE :
-                return; // Exit function, because quit command was invoked
-                break;
-            case GLFW_KEY_R :
-                return;
-                break;
-            default:
-                break;
-        }
-    } while(input_key != GLFW_KEY_UNKNOWN);
+            return apply_input(SimulationUtil::Input::SOFT_DROP);
+        case GLFW_KEY_SPACE :
+#ifndef NDEBUG
+            std::cerr << "Input: Space\n";
+#endif
+            return apply_input(SimulationUtil::Input::HARD_DROP);
+        case GLFW_KEY_ESCAPE :
+            return false; // Skip rest of tick, because quit command was invoked
+        case GLFW_KEY_R :
+            return false;
+        default:
+            return true;
+    }
+}
 
-    // Handle game over
-    for (auto& t : landed) {
-        if (t.get_top_left_point().y <= 1) {
-            game_over = true;
+bool Game::apply_auto_shift() {
+    SimulationUtil::Input input;
+    while (auto_shift.take_move(input)) {
+        if (!apply_input(input)) {
+            return false;
         }
     }
+    return true;
+}
+
+bool Game::apply_input(SimulationUtil::Input input) {
+    // Versus inputs are applied on the session's next tick, which may be rolled back and played again
+    if (versus) {
+        versus->queue_local_input(input);
+        return true;
+    }
+
+    flight_recorder.record_input(input);
+    if (replay_writer) {
+        replay_writer->record_input(input);
+    }
+
+    return simulation.handle_input(input);
+}
+
+void Game::handle_simulation_events() {
+    uint32_t events = versus ? versus->consume_local_events() : simulation.consume_events();
+
+    if (events & SimulationUtil::EVENT_MOVED) {
+        sound_component.play_sfx(SoundUtil::SFXSound::MOVE);
+    }
+
+    // Play sound according to how many rows were cleared
+    if (events & SimulationUtil::EVENT_TETRIS) {
+        sound_component.play_sfx(SoundUtil::SFXSound::TETRIS);
+    } else if (events & SimulationUtil::EVENT_LINE_CLEAR) {
+        sound_component.play_sfx(SoundUtil::SFXSound::LINE_CLEAR);
+    }
+
+    if (events & SimulationUtil::EVENT_GAME_OVER) {
+        submit_high_score();
+    }
+
+    // Let an attached bot know about the new tetromino, or that the game has ended
+    if (events & (SimulationUtil::EVENT_SPAWNED | SimulationUtil::EVENT_GAME_OVER)) {
+        publish_bot_snapshot();
+    }
+    if (events & SimulationUtil::EVENT_SPAWNED) {
+        bot_move_pending = true;
+    }
+}
+
+void Game::submit_high_score() {
+    // Replays were already scored when they were played, and versus games are not scored alone
+    if (replay_reader || versus || !high_scores) {
+        return;
+    }
+
+    HighScoreUtil::Record record;
+    std::memset(&record, 0, sizeof(record));
+    record.score = simulation.get_score();
+    record.lines_cleared = simulation.get_lines_cleared();
+    record.timestamp = static_cast<uint64_t>(std::time(nullptr));
+    record.seed = simulation.get_seed();
+    const char* name = std::getenv("USER");
+    std::strncpy(record.name, name != nullptr ? name : "Player", sizeof(record.name) - 1);
+
+    try {
+        high_score_rank = high_scores->submit(record);
+    } catch (std::runtime_error& e) {
+        // Runs on the simulation thread, where an escaping exception would end the game
+        // Without a working log there is no leaderboard for the rest of the session
+#ifndef NDEBUG
+        std::cerr << e.what() << "\n";
+#endif
+        high_scores.reset();
+        return;
+    }
+    best_score = std::max(best_score, record.score);
+}
+
+void Game::save_game() {
+    // Watching a replay or someone else is not a session of its own, and versus needs the peer to carry on
+    if (replay_reader || versus || spectator_client) {
+        return;
+    }
+
+    if (simulation.is_game_over()) {
+        SaveFile::remove(save_path);
+        return;
+    }
+
+#ifndef NDEBUG
+    double start_time = glfwGetTime();
+#endif
+    try {
+        SaveFile::save(save_path, simulation.save_state());
+    } catch (std::runtime_error& e) {
+        // Losing the save is better than losing the game being played
+#ifndef NDEBUG
+        std::cerr << e.what() << "\n";
+#endif
+        return;
+    }
+#ifndef NDEBUG
+    std::cerr << "Saved game in " << (glfwGetTime() - start_time) * 1000.0 << "ms\n";
+#endif
+}
 
-    // Move down current tetromino if time passed
-    if ((glfwGetTime() - previous_tetromino_move_time) >= TIME_BETWEEN_TETROMINO_MOVEMENTS) {
-        current_tetromino.translate_down(false);
-        previous_tetromino_move_time = glfwGetTime();
+void Game::feed_auto_shift(const InputQueueUtil::Event& event) {
+    AutoShiftUtil::Direction direction = AutoShiftUtil::NONE;
+    if (event.key == GLFW_KEY_LEFT) {
+        direction = AutoShiftUtil::LEFT;
+    } else if (event.key == GLFW_KEY_RIGHT) {
+        direction = AutoShiftUtil::RIGHT;
     }
 
+    // OS key repeats are ignored, the repeats are timed from the press instead
+    if (direction != AutoShiftUtil::NONE && event.action == InputQueueUtil::Action::PRESS) {
+        auto_shift.press(direction, event.timestamp);
+    } else if (direction != AutoShiftUtil::NONE && event.action == InputQueueUtil::Action::RELEASE) {
+        auto_shift.release(direction, event.timestamp);
+    } else {
+        auto_shift.advance(event.timestamp);
+    }
 }
 
 int Game::window_control() {
-    auto input_key = input_queue.fetch();
+    // Only key presses do anything yet
+    InputQueueUtil::Event event;
+    int input_key = GLFW_KEY_UNKNOWN;
+    while (input_queue.fetch(event, tick_deadline)) {
+        feed_auto_shift(event);
+        if (event.action == InputQueueUtil::Action::PRESS) {
+            input_key = event.key;
+            break;
+        }
+    }
+
+    // Follow this press to the screen, unless the last one followed is still on its way
+    if (input_key != GLFW_KEY_UNKNOWN &&
+        latency_sequence == latency_drawn_sequence.load(std::memory_order_acquire)) {
+        ++latency_sequence;
+        latency_input_time = event.timestamp;
+    }
 
     switch(input_key) {
         case GLFW_KEY_ESCAPE :
@@ -244,13 +840,26 @@ int Game::window_control() {
 #ifndef NDEBUG
             std::cerr << "Input: R (Reset)\n";
 #endif
+            if (versus || spectator_client) {
+                break; // The game carries on regardless
+            }
             paused = !paused;
+            auto_shift.reset(); // Keys held through a pause start over
+            if (paused) {
+                save_game();
+            }
+            break;
+        case GLFW_KEY_F9 :
+#ifndef NDEBUG
+            std::cerr << "Input: F9 (Dump flight recorder)\n";
+#endif
+            flight_recorder.dump();
             break;
     }
 
 
-    if (view_component.should_window_close()) {
-        close_game = true;
+    // Set by the render thread when the window is closed
+    if (close_game) {
         return GLFW_KEY_ESCAPE; // Exit function, because quit command was invoked
     }
 
@@ -259,155 +868,80 @@ int Game::window_control() {
     return input_key;
 }
 
-void Game::handle_row_clearing() {
-    // Get estimate for how high to check
-    int row_clearing_cap = GAME_HEIGHT;
-    for (auto &t : landed) {
-        int top_left_y = t.get_top_left_point().y;
-
-        if (top_left_y < row_clearing_cap) {
-            row_clearing_cap = top_left_y;
-        }
+bool Game::is_game_finished() const {
+    // In versus the game is only over once both sides agree on it
+    if (versus) {
+        return versus->is_finished();
     }
+    return active_simulation().is_game_over();
+}
 
-
-    // Row clearing
-    // -----------
-    // Clears rows and stores rows to move down in ranges
-
-    struct RowMoveRanges {
-        struct {
-            int lowest_cleared_row;
-            int highest_cleared_row;
-        } range;
-
-        int rows_cleared;
-    };
-    std::vector<RowMoveRanges> row_move_ranges;
-
-    int lowest_cleared_row = -1;
-    int highest_cleared_row = -1;
-    bool create_range = false;
-    int rows_cleared = 0;
-
-    for (int y = GAME_HEIGHT - 1; y >= row_clearing_cap; --y) {
-        // Determine if row is full
-        bool row_full = true;
-        for (int x = 0; x < GAME_WIDTH; ++x) {
-            bool found_block = false;
-            for (auto& l : landed) {
-                if (l.block_exists(glm::ivec2{x, y})) {
-                    found_block = true;
-                }
-            }
-            if (!found_block) {
-                row_full = false;
-            }
-        }
-
-        // If row is full proceed to clear
-        if (row_full) {
-
-            // Store range of blocks to move down
-            if (create_range) {
-                row_move_ranges.push_back({{lowest_cleared_row, highest_cleared_row}, rows_cleared});
-
-                // Reset counters
-                lowest_cleared_row = -1;
-                create_range = false;
-            }
-
-            ++rows_cleared;
-            lowest_cleared_row = y - 1;
-            for (int x = 0; x < GAME_WIDTH; ++x) {
-                for (auto& l : landed) {
-                    l.remove_block(glm::ivec2{x, y});
-                }
-            }
-
-        } else {
-            highest_cleared_row = y;
-            if (lowest_cleared_row != -1) {
-                create_range = true;
-            }
-        }
+const Simulation& Game::active_simulation() const {
+    if (versus) {
+        return versus->get_local_simulation();
     }
-
-
-    // Create final range
-    // if necessary
-    if (create_range) {
-        row_move_ranges.push_back({{lowest_cleared_row, highest_cleared_row}, rows_cleared});
+    if (spectator_client) {
+        return spectator_client->get_simulation();
     }
+    return simulation;
+}
 
-    // Move down ranges
-    // according to amount of rows cleared
-    // when they were reached
-    if (!row_move_ranges.empty()) {
-        for (auto &r : row_move_ranges) {
-            // Get all blocks above deleted row to move down
-            std::vector<glm::ivec2> blocks_to_move_down;
-            for (auto& l : landed) {
-                auto blocks = l.get_blocks();
-                for (auto& b : blocks) {
-                    if (r.range.lowest_cleared_row >= b.y && r.range.highest_cleared_row <= b.y) {
-                        blocks_to_move_down.push_back(b);
-                    }
-                }
-                l.translate_blocks_down(blocks_to_move_down, r.rows_cleared);
-                blocks_to_move_down.clear();
-            }
-        }
+void Game::publish_bot_snapshot() {
+    if (!bot_bridge) {
+        return;
     }
 
-
-    // Scoring
-    // ------
-
-    // Lookup table which matches the rows cleared with the score to be awarded
-    static const int ROWS_CLEARED_SCORING_TABLE[4] = {
-            40,
-            100,
-            300,
-            1200,
-    };
-    if (rows_cleared >= 1 && rows_cleared <= 4) {
-        score += ROWS_CLEARED_SCORING_TABLE[rows_cleared - 1];
+    // Written straight into the slot the bot reads from
+    BotProtocol::Snapshot* snapshot = bot_bridge->begin_snapshot();
+    if (snapshot == nullptr) {
+        return; // Bot has fallen behind, it will pick up the next snapshot instead
     }
 
-    // Play sound according to how many rows were cleared
-    if (rows_cleared >= 4) {
-        sound_component.play_sfx(SoundUtil::SFXSound::TETRIS);
-    } else if (rows_cleared >= 1 && rows_cleared < 4) {
-        sound_component.play_sfx(SoundUtil::SFXSound::LINE_CLEAR);
+    const Simulation& shown = active_simulation();
+    const Tetromino& current_tetromino = shown.get_current_tetromino();
+    snapshot->score = shown.get_score();
+    snapshot->game_over = shown.is_game_over();
+
+    snapshot->current_type = static_cast<uint8_t>(current_tetromino.get_type());
+    snapshot->current_rotation = static_cast<uint8_t>(current_tetromino.get_rotation_state());
+    snapshot->current_x = static_cast<int8_t>(current_tetromino.get_top_left_point().x);
+    snapshot->current_y = static_cast<int8_t>(current_tetromino.get_top_left_point().y);
+    for (int r = 0; r < 4; ++r) {
+        uint16_t mask = 0;
+        for (auto& b : Tetromino::relative_blocks(current_tetromino.get_type(), r)) {
+            mask |= 1u << (b.y * 4 + b.x);
+        }
+        snapshot->rotation_masks[r] = mask;
     }
 
-    // Freeing memory
-    // --------------
+    for (unsigned int i = 0; i < NEXT_QUEUE_SIZE; ++i) {
+        snapshot->next[i] = static_cast<uint8_t>(shown.get_next_queue()[i]);
+    }
 
-    // Find and delete all tetrominos with no blocks
-    std::remove_if(landed.begin(), landed.end(), [](const Tetromino& t) -> bool {
-        return (t.num_blocks() == 0);
-    });
+    static_assert(sizeof(snapshot->cells) == Board::size_in_bytes(), "Bot snapshot must match board layout");
+    std::memcpy(snapshot->cells, shown.get_board().data(), Board::size_in_bytes());
 
+    bot_bridge->publish_snapshot();
 }
 
-void Game::add_landed(const Tetromino& tetromino) {
-    landed.push_back(tetromino);
-
-    if (tetromino.highest_block() <= 1) {
-        game_over = true;
+bool Game::apply_bot_plugin_move() {
+    tetris_bot_move move;
+    if (!bot_plugin->suggest_move(simulation.get_board(), simulation.get_current_tetromino(),
+                                  simulation.get_next_queue(), simulation.get_score(), move)) {
+        return true; // No move this time, the tetromino is left to gravity
     }
 
-    handle_row_clearing();
-}
-
-bool Game::check_collision(const Tetromino& new_pos) const {
-    for (auto iter = landed.cbegin(); iter != landed.cend(); ++iter) {
-        if (iter->tetromino_overlaps(new_pos)) {
-            return true;
-        }
+    // Apply the move as inputs so it goes through the same checks as a player
+    for (int r = 0; r < move.rotations; ++r) {
+        apply_input(SimulationUtil::Input::ROTATE);
+    }
+    SimulationUtil::Input shift_input = (move.shift < 0) ? SimulationUtil::Input::LEFT : SimulationUtil::Input::RIGHT;
+    for (int s = 0; s < std::abs(static_cast<int>(move.shift)); ++s) {
+        apply_input(shift_input);
+    }
+    if (move.hard_drop) {
+        return apply_input(SimulationUtil::Input::HARD_DROP);
     }
 
-    return false;
-}
\ No newline at end of file
+    return true;
+}
@@ -5,15 +5,30 @@
 #ifndef INC_3D_TETRIS_GAME_H
 #define INC_3D_TETRIS_GAME_H
 
-#include "Tetromino.h"
+#include "Simulation.h"
 #include "Constants.h"
 
 #include "InputQueue.h"
 #include "ViewComponent.h"
 #include "RandomNumberComponent.h"
 #include "SoundComponent.h"
+#include "BotBridge.h"
+#include "BotPluginHost.h"
+#include "Replay.h"
+#include "SaveFile.h"
+#include "HighScoreTable.h"
+#include "FlightRecorder.h"
+#include "Versus.h"
+#include "SpectatorLink.h"
+#include "RenderSnapshot.h"
+#include "Util/TripleBuffer.h"
+#include "FrameLimiter.h"
+#include "LatencyHistogram.h"
+#include "AutoShift.h"
 
-#include <vector>
+#include <atomic>
+#include <memory>
+#include <string>
 #include <glm/vec2.hpp>
 
 class Game {
@@ -23,32 +38,121 @@ public:
     void begin();
     void reset();
 
-    void add_landed(const Tetromino& t);
-    bool check_collision(const Tetromino& new_pos) const;
+    // Plays a replay for a fixed number of frames as fast as the renderer goes, instead of begin()
+    // Prints the frame times and the GL work done per frame, to compare renderers and builds
+    void benchmark(const std::string& replay_path, uint32_t frames);
+
+    // Publish board snapshots to, and take moves from, an external bot process
+    void attach_bot_bridge(const std::string& shm_name);
+
+    // Let a bot plugin loaded with dlopen play the game
+    void attach_bot_plugin(const std::string& library_path, double time_limit);
+
+    // Record the game being played, or watch a recorded one instead of playing
+    void start_recording(const std::string& replay_path);
+    void start_playback(const std::string& replay_path);
+
+    // How long left or right is held before it repeats, and how often it then repeats
+    void set_auto_shift(double das_seconds, double arr_seconds);
+
+    // How frames are presented, and whether the achieved frame times are shown and printed on exit
+    void set_present_mode(FrameLimiterUtil::PresentMode mode, double target_fps, bool show_stats);
+
+    // Show input latency on screen, and write the histograms to the given path on exit
+    void measure_latency(const std::string& dump_path);
+
+    // Picks up the game saved on the last pause or quit, returns false if there is none
+    bool resume_saved_game();
+
+    // Play against another instance over UDP instead of alone
+    // Latency and loss are added to outgoing packets, to try out bad connections
+    void start_versus(unsigned int player, uint16_t local_port, const std::string& remote_host, uint16_t remote_port,
+                      double latency_seconds, double loss_fraction);
+
+    // Stream the game to spectators on a TCP port, or watch a game streamed by another instance
+    void start_broadcast(uint16_t port);
+    void start_spectating(const std::string& host, uint16_t port);
 
     RandomNumberComponent rng_component;
 private:
+    // Runs on its own thread, ticking the game and publishing render snapshots
+    void simulation_loop();
+    void update(); // One tick of whatever the game is doing
+    void publish_render_snapshot();
+    // Render thread only, tick_progress is how far through the tick the frame is drawn, from 0 to 1
+    void render(const RenderUtil::Snapshot& snapshot, float frame_seconds, float tick_progress);
+    void record_latency(const RenderUtil::Snapshot& snapshot, double drawn_time, double swapped_time);
+    void dump_latency() const;
+    glm::vec2 interpolation_offset(const RenderUtil::Snapshot& snapshot, float tick_progress) const; // Where to draw the current tetromino
+
     void tick();
+    void step(); // Runs the simulation for one tick
+    void playback_tick();
+    void versus_tick();
+    void spectate_tick();
+    void broadcast(); // Sends the state after a tick to any spectators
     int window_control(); // Returns fetched key
-    void handle_row_clearing();
+    void feed_auto_shift(const InputQueueUtil::Event& event);
+    bool apply_auto_shift(); // Returns false if the rest of the tick should be skipped
+    bool handle_key(int key); // Returns false if the rest of the tick should be skipped
+    bool apply_input(SimulationUtil::Input input); // Returns false if the rest of the tick should be skipped
+    void handle_simulation_events();
+    void save_game(); // Also removes the save once the game is over
+    void submit_high_score();
+
+    bool is_game_finished() const;
+    const Simulation& active_simulation() const; // The local player's in versus, the streamed one when spectating
+
+    void publish_bot_snapshot();
+    bool apply_bot_plugin_move(); // Returns false if the rest of the tick should be skipped
 
     ViewComponent view_component;
     InputQueue    input_queue;
+    AutoShift     auto_shift{AutoShiftUtil::DEFAULT_DAS, AutoShiftUtil::DEFAULT_ARR}; // Simulation thread only
     SoundComponent sound_component;
 
-    Tetromino current_tetromino;
-    Tetromino ghost_tetromino; // Used to indicate where the tetromino will land
-    std::vector<Tetromino> landed;
+    Simulation simulation;
 
-    bool game_over = false;
-    bool close_game = false;
-    bool paused = false;
-    unsigned int score = 0;
+    std::unique_ptr<BotBridge> bot_bridge;
+    std::unique_ptr<BotPluginHost> bot_plugin;
+    bool bot_move_pending = false; // Set when a tetromino spawns until the plugin has been asked
+
+    FlightRecorder flight_recorder; // Always running, dumped with F9 or on a crash
+    std::unique_ptr<ReplayWriter> replay_writer;
+    std::unique_ptr<ReplayReader> replay_reader;
+
+    std::unique_ptr<VersusSession> versus;
+
+    std::unique_ptr<SpectatorServer> spectator_server;
+    std::unique_ptr<SpectatorClient> spectator_client;
+
+    std::string save_path;
 
-    // Last time the current tetromino moved down
-    double previous_tetromino_move_time;
+    std::unique_ptr<HighScoreTable> high_scores; // Left empty when the shared files can not be used
+    uint32_t best_score = 0; // Cached so drawing never has to lock the table
+    int high_score_rank = -1; // Rank of the last finished game, or -1 if it did not make the table
+
+    Util::TripleBuffer<RenderUtil::Snapshot> render_snapshots;
+    FrameLimiter frame_limiter{FrameLimiterUtil::PresentMode::VSYNC, 0.0}; // Render thread only
+    bool show_frame_stats = false;
+    uint32_t simulation_ticks = 0;
+    double last_tick_time = 0.0;
+    double tick_deadline = 0.0; // When the tick being run was due, input after it is left for the next one
+    TetrominoUtil::Pose pose_before_tick;
+    uint8_t published_rotation = RenderUtil::ROTATION_NONE;
+
+    // One input is followed at a time, from the key callback until the frame showing it is swapped
+    // The simulation thread starts following a new one once the render thread has stored the last one's sequence
+    uint32_t latency_sequence = 0;
+    double latency_input_time = 0.0;
+    std::atomic<uint32_t> latency_drawn_sequence{0};
+    LatencyHistogram input_to_draw; // Render thread only
+    LatencyHistogram input_to_swap;
+    std::string latency_path;
+
+    std::atomic<bool> close_game{false}; // Set by either thread
+    bool paused = false;
 };
 
 
 #endif //INC_3D_TETRIS_GAME_H
-
@@ -0,0 +1,180 @@
+#include "HighScoreTable.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+static_assert(std::is_trivially_copyable<HighScoreUtil::Record>::value, "High score records are written as they are");
+
+namespace {
+    // Holds an flock for as long as it is in scope
+    class FileLock {
+    public:
+        FileLock(int fd, int operation) : fd(fd) { flock(fd, operation); }
+        ~FileLock() { flock(fd, LOCK_UN); }
+    private:
+        int fd;
+    };
+
+    off_t record_offset(uint64_t position) {
+        return static_cast<off_t>(sizeof(HighScoreUtil::LogHeader) + position * sizeof(HighScoreUtil::Record));
+    }
+}
+
+HighScoreTable::HighScoreTable(const std::string& log_path, const std::string& index_path) {
+    log_fd = open(log_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (log_fd == -1) {
+        throw std::runtime_error(std::string("fatal error: Failed to open high score log\nLog path: ") + log_path);
+    }
+    index_fd = open(index_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (index_fd == -1) {
+        close(log_fd);
+        throw std::runtime_error(std::string("fatal error: Failed to open high score index\nIndex path: ") + index_path);
+    }
+
+    FileLock lock(index_fd, LOCK_EX);
+
+    // New log
+    struct stat log_stat;
+    fstat(log_fd, &log_stat);
+    if (log_stat.st_size == 0) {
+        HighScoreUtil::LogHeader header;
+        std::memcpy(header.magic, HighScoreUtil::LOG_MAGIC, sizeof(header.magic));
+        header.version = HighScoreUtil::VERSION;
+        header.record_size = sizeof(HighScoreUtil::Record);
+        header.padding = 0;
+        if (pwrite(log_fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            close(log_fd);
+            close(index_fd);
+            throw std::runtime_error(std::string("fatal error: Failed to write high score log\nLog path: ") + log_path);
+        }
+    } else {
+        HighScoreUtil::LogHeader header;
+        if (pread(log_fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+            std::memcmp(header.magic, HighScoreUtil::LOG_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != HighScoreUtil::VERSION || header.record_size != sizeof(HighScoreUtil::Record)) {
+            close(log_fd);
+            close(index_fd);
+            throw std::runtime_error(std::string("fatal error: High score log is corrupt or from another version\nLog path: ") + log_path);
+        }
+    }
+
+    struct stat index_stat;
+    fstat(index_fd, &index_stat);
+    bool fresh_index = index_stat.st_size != static_cast<off_t>(sizeof(HighScoreUtil::IndexFile));
+    if (fresh_index && ftruncate(index_fd, sizeof(HighScoreUtil::IndexFile)) == -1) {
+        close(log_fd);
+        close(index_fd);
+        throw std::runtime_error(std::string("fatal error: Failed to size high score index\nIndex path: ") + index_path);
+    }
+
+    void* mapping = mmap(nullptr, sizeof(HighScoreUtil::IndexFile), PROT_READ | PROT_WRITE, MAP_SHARED, index_fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(log_fd);
+        close(index_fd);
+        throw std::runtime_error(std::string("fatal error: Failed to map high score index\nIndex path: ") + index_path);
+    }
+    index = static_cast<HighScoreUtil::IndexFile*>(mapping);
+
+    // A missing or outdated index is rebuilt from the log, which is the only time the whole log is read
+    if (fresh_index || std::memcmp(index->magic, HighScoreUtil::INDEX_MAGIC, sizeof(index->magic)) != 0 ||
+        index->version != HighScoreUtil::VERSION || index->record_size != sizeof(HighScoreUtil::Record)) {
+        std::memset(index, 0, sizeof(HighScoreUtil::IndexFile));
+        std::memcpy(index->magic, HighScoreUtil::INDEX_MAGIC, sizeof(index->magic));
+        index->version = HighScoreUtil::VERSION;
+        index->record_size = sizeof(HighScoreUtil::Record);
+    }
+
+    catch_up();
+}
+
+HighScoreTable::~HighScoreTable() {
+    munmap(index, sizeof(HighScoreUtil::IndexFile));
+    close(log_fd);
+    close(index_fd);
+}
+
+int HighScoreTable::submit(const HighScoreUtil::Record& record) {
+    FileLock lock(index_fd, LOCK_EX);
+    catch_up();
+
+    // Written at a fixed position rather than appended, so it replaces any torn record left by a crash
+    if (pwrite(log_fd, &record, sizeof(record), record_offset(index->log_records)) != static_cast<ssize_t>(sizeof(record))) {
+        throw std::runtime_error("fatal error: Failed to append to high score log");
+    }
+
+    int rank = insert(record);
+    ++index->log_records;
+    return rank;
+}
+
+size_t HighScoreTable::read_top(HighScoreUtil::Record* records, size_t max_records) const {
+    FileLock lock(index_fd, LOCK_SH);
+    size_t count = std::min<size_t>(index->count, max_records);
+    std::memcpy(records, index->top, count * sizeof(HighScoreUtil::Record));
+    return count;
+}
+
+uint32_t HighScoreTable::get_best_score() const {
+    FileLock lock(index_fd, LOCK_SH);
+    return index->count > 0 ? index->top[0].score : 0;
+}
+
+uint64_t HighScoreTable::get_num_records() const {
+    FileLock lock(index_fd, LOCK_SH);
+    return index->log_records;
+}
+
+void HighScoreTable::catch_up() {
+    struct stat log_stat;
+    if (fstat(log_fd, &log_stat) == -1) {
+        return;
+    }
+
+    // A torn record at the end is not counted
+    uint64_t log_records = (static_cast<uint64_t>(log_stat.st_size) - sizeof(HighScoreUtil::LogHeader)) /
+                           sizeof(HighScoreUtil::Record);
+    if (log_records <= index->log_records) {
+        return;
+    }
+
+    // Read in batches instead of one record at a time
+    static constexpr size_t BATCH = 4096;
+    std::vector<HighScoreUtil::Record> batch(BATCH);
+    while (index->log_records < log_records) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(BATCH, log_records - index->log_records));
+        ssize_t bytes = pread(log_fd, batch.data(), count * sizeof(HighScoreUtil::Record), record_offset(index->log_records));
+        if (bytes != static_cast<ssize_t>(count * sizeof(HighScoreUtil::Record))) {
+            break;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            insert(batch[i]);
+        }
+        index->log_records += count;
+    }
+}
+
+int HighScoreTable::insert(const HighScoreUtil::Record& record) {
+    // Ties go to whoever got there first
+    uint32_t rank = 0;
+    while (rank < index->count && index->top[rank].score >= record.score) {
+        ++rank;
+    }
+    if (rank >= HIGH_SCORE_TABLE_SIZE) {
+        return -1;
+    }
+
+    uint32_t last = std::min<uint32_t>(index->count, HIGH_SCORE_TABLE_SIZE - 1);
+    std::memmove(&index->top[rank + 1], &index->top[rank], (last - rank) * sizeof(HighScoreUtil::Record));
+    index->top[rank] = record;
+    index->count = std::min<uint32_t>(index->count + 1, HIGH_SCORE_TABLE_SIZE);
+    return static_cast<int>(rank);
+}
@@ -0,0 +1,75 @@
+#ifndef INC_3D_TETRIS_HIGHSCORETABLE_H
+#define INC_3D_TETRIS_HIGHSCORETABLE_H
+
+#include "Constants.h"
+#include "Util/NonCopyable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * High score files
+ * ----------------
+ * Log:   LogHeader, then every submitted Record, one after another, never rewritten
+ * Index: IndexFile, the top HIGH_SCORE_TABLE_SIZE records sorted best first,
+ *        memory mapped and updated in place
+ *
+ * The index remembers how many log records it has seen, so records appended by a process
+ * which died before updating the index are picked up by the next one to open it.
+ * Both files are shared between processes, updates are serialised with flock on the index.
+ */
+namespace HighScoreUtil {
+    static constexpr char LOG_MAGIC[4]   = {'T', '3', 'D', 'L'};
+    static constexpr char INDEX_MAGIC[4] = {'T', '3', 'D', 'H'};
+    static constexpr uint32_t VERSION = 1;
+
+    struct Record {
+        uint32_t score;
+        uint32_t lines_cleared;
+        uint64_t timestamp; // Seconds since the epoch
+        uint32_t seed;      // Of the game, so it can be found again in replays
+        char     name[20];  // Null terminated
+    };
+
+    struct LogHeader {
+        char     magic[4];
+        uint32_t version;
+        uint32_t record_size;
+        uint32_t padding;
+    };
+
+    struct IndexFile {
+        char     magic[4];
+        uint32_t version;
+        uint32_t record_size;
+        uint32_t count;       // Valid entries in top
+        uint64_t log_records; // Log records already considered for the top
+        Record   top[HIGH_SCORE_TABLE_SIZE];
+    };
+}
+
+class HighScoreTable : public Util::NonCopyable {
+public:
+    HighScoreTable(const std::string& log_path, const std::string& index_path);
+    ~HighScoreTable();
+
+    // Appends the record to the log, returning its rank in the top table or -1
+    int submit(const HighScoreUtil::Record& record);
+
+    // Copies out up to max_records of the top table, best first
+    size_t read_top(HighScoreUtil::Record* records, size_t max_records) const;
+
+    uint32_t get_best_score() const;
+    uint64_t get_num_records() const;
+private:
+    void catch_up(); // Indexes log records the index has not seen yet
+    int insert(const HighScoreUtil::Record& record); // Returns the rank or -1
+
+    int log_fd;
+    int index_fd;
+    HighScoreUtil::IndexFile* index;
+};
+
+
+#endif //INC_3D_TETRIS_HIGHSCORETABLE_H
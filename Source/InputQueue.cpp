@@ -4,21 +4,30 @@
 
 #include "InputQueue.h"
 
-#include <algorithm>
-
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    if (key == 0) {
+    if (key == 0 || key == GLFW_KEY_UNKNOWN) {
         return;
     }
 
-    if (action == GLFW_PRESS) {
-        auto input_queue = static_cast<InputQueue*>(glfwGetWindowUserPointer(window));
-
-        if (input_queue->queue.size() >= InputQueue::MAX_ELEMENTS_IN_QUEUE - 1) {
-            input_queue->queue.pop_back();
-        }
+    InputQueueUtil::Event event;
+    event.key = key;
+    event.timestamp = glfwGetTime();
+    switch (action) {
+        case GLFW_PRESS :
+            event.action = InputQueueUtil::Action::PRESS;
+            break;
+        case GLFW_REPEAT :
+            event.action = InputQueueUtil::Action::REPEAT;
+            break;
+        default:
+            event.action = InputQueueUtil::Action::RELEASE;
+            break;
+    }
 
-        input_queue->queue.push_front(key);
+    // Events received while the queue is full are dropped
+    auto input_queue = static_cast<InputQueue*>(glfwGetWindowUserPointer(window));
+    if (!input_queue->queue.push(event)) {
+        input_queue->dropped.fetch_add(1, std::memory_order_relaxed);
     }
 }
 
@@ -30,12 +39,12 @@ InputQueue::InputQueue(GLFWwindow* win) : window(win) {
     glfwSetKeyCallback(window, key_callback);
 }
 
-InputQueue::GLFWkey InputQueue::fetch() {
-    if (queue.empty()) {
-        return GLFW_KEY_UNKNOWN;
-    } else {
-        GLFWkey back = queue.back();
-        queue.pop_back();
-        return back;
+bool InputQueue::fetch(InputQueueUtil::Event& event, double until) {
+    const InputQueueUtil::Event* next = queue.front();
+    if (next == nullptr || next->timestamp > until) {
+        return false;
     }
+    event = *next;
+    queue.pop();
+    return true;
 }
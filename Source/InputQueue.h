@@ -7,22 +7,43 @@
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
-#include <deque>
-#include <memory>
-
+#include "Util/SpscRing.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace InputQueueUtil {
+    enum class Action : uint8_t {
+        PRESS,
+        REPEAT, // Sent by the OS while a key is held down
+        RELEASE,
+    };
+
+    struct Event {
+        int    key;
+        Action action;
+        double timestamp; // glfwGetTime() when the event was received
+    };
+}
+
+// Key events are pushed by the GLFW callback on the render thread and fetched by the simulation thread
 class InputQueue {
-    using GLFWkey = int;
 public:
     // Set callback as friend
     friend void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
     explicit InputQueue(GLFWwindow* win);
 
-    GLFWkey fetch();
+    // Fetches the oldest event received no later than the given time
+    // Returns false if there is none, leaving newer events for a later tick
+    bool fetch(InputQueueUtil::Event& event, double until);
+
+    uint32_t get_dropped() const { return dropped.load(std::memory_order_relaxed); } // Events lost to a full queue
 private:
-    static constexpr int MAX_ELEMENTS_IN_QUEUE = 20;
+    static constexpr uint32_t MAX_ELEMENTS_IN_QUEUE = 64;
 
-    std::deque<GLFWkey> queue;
+    Util::SpscRing<InputQueueUtil::Event, MAX_ELEMENTS_IN_QUEUE> queue;
+    std::atomic<uint32_t> dropped{0};
     GLFWwindow* window;
 };
 
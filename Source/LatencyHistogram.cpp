@@ -0,0 +1,46 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <ostream>
+
+void LatencyHistogram::add(double ms) {
+    using namespace LatencyHistogramUtil;
+
+    ms = std::max(ms, 0.0);
+    uint32_t bucket = static_cast<uint32_t>(std::min(ms / BUCKET_MS, static_cast<double>(NUM_BUCKETS - 1)));
+    ++buckets[bucket];
+    ++count;
+    sum_ms += ms;
+    max_ms = std::max(max_ms, ms);
+}
+
+double LatencyHistogram::get_percentile_ms(double percentile) const {
+    using namespace LatencyHistogramUtil;
+
+    if (count == 0) {
+        return 0.0;
+    }
+
+    // Rank of the sample the percentile falls on, counting from one
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(percentile / 100.0 * count + 0.5));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min((i + 1) * BUCKET_MS, max_ms);
+        }
+    }
+    return max_ms;
+}
+
+void LatencyHistogram::write(std::ostream& out, const std::string& name) const {
+    using namespace LatencyHistogramUtil;
+
+    out << "# " << name << ": " << count << " samples, mean " << get_mean_ms() << "ms, p50 "
+        << get_percentile_ms(50.0) << "ms, p99 " << get_percentile_ms(99.0) << "ms, max " << max_ms << "ms\n";
+    for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+        if (buckets[i] != 0) {
+            out << name << " " << i * BUCKET_MS << " " << buckets[i] << "\n";
+        }
+    }
+}
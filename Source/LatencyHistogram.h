@@ -0,0 +1,34 @@
+#ifndef INC_3D_TETRIS_LATENCYHISTOGRAM_H
+#define INC_3D_TETRIS_LATENCYHISTOGRAM_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace LatencyHistogramUtil {
+    static constexpr double   BUCKET_MS   = 0.25;
+    static constexpr uint32_t NUM_BUCKETS = 400; // Up to 100ms, anything slower lands in the last bucket
+}
+
+// Fixed size histogram of latencies in milliseconds, so recording never allocates
+class LatencyHistogram {
+public:
+    void add(double ms);
+
+    // Getters
+    uint64_t get_count() const { return count; }
+    double get_mean_ms() const { return count != 0 ? sum_ms / count : 0.0; }
+    double get_max_ms() const { return max_ms; }
+    double get_percentile_ms(double percentile) const; // The upper edge of the bucket the percentile falls in
+
+    // Writes a summary line then "bucket_ms count" for every bucket with samples, under the given name
+    void write(std::ostream& out, const std::string& name) const;
+private:
+    uint64_t buckets[LatencyHistogramUtil::NUM_BUCKETS] = {};
+    uint64_t count = 0;
+    double sum_ms = 0.0;
+    double max_ms = 0.0;
+};
+
+
+#endif //INC_3D_TETRIS_LATENCYHISTOGRAM_H
@@ -4,7 +4,9 @@
 
 #include "RandomNumberComponent.h"
 
-RandomNumberComponent::RandomNumberComponent() : gen(std::random_device()()) { }
+RandomNumberComponent::RandomNumberComponent() {
+    seed();
+}
 
 void RandomNumberComponent::seed() {
     gen.seed(std::random_device()());
@@ -16,4 +18,4 @@ void RandomNumberComponent::seed(int s) {
 
 int RandomNumberComponent::rng(int lower_bound, int upper_bound) {
     return std::uniform_int_distribution<>(lower_bound, upper_bound)(gen);
-}
\ No newline at end of file
+}
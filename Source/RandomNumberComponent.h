@@ -5,8 +5,38 @@
 #ifndef INC_3D_TETRIS_RANDOMNUMBERCOMPONENT_H
 #define INC_3D_TETRIS_RANDOMNUMBERCOMPONENT_H
 
+#include <cstdint>
 #include <random>
 
+namespace RandomNumberUtil {
+    // Park-Miller minimal standard generator, the same sequence as std::minstd_rand
+    // Its whole state is one word, so it can be saved and restored with the rest of the game
+    class MinStdEngine {
+    public:
+        using result_type = uint32_t;
+
+        static constexpr result_type min() { return 1; }
+        static constexpr result_type max() { return MODULUS - 1; }
+
+        void seed(uint32_t s) {
+            state = s % MODULUS;
+            if (state == 0) {
+                state = 1;
+            }
+        }
+
+        result_type operator()() {
+            state = static_cast<uint32_t>((static_cast<uint64_t>(state) * MULTIPLIER) % MODULUS);
+            return state;
+        }
+
+        uint32_t state = 1;
+    private:
+        static constexpr uint32_t MULTIPLIER = 48271;
+        static constexpr uint32_t MODULUS = 2147483647;
+    };
+}
+
 class RandomNumberComponent {
 public:
     RandomNumberComponent();
@@ -15,8 +45,12 @@ public:
     void seed(int s);
 
     int rng (int lower_bound, int upper_bound);
+
+    // Saving and restoring the generator
+    uint32_t get_state() const { return gen.state; }
+    void set_state(uint32_t state) { gen.state = state; }
 private:
-    std::mt19937 gen;
+    RandomNumberUtil::MinStdEngine gen;
 };
 
 
@@ -0,0 +1,61 @@
+#ifndef INC_3D_TETRIS_RENDERSNAPSHOT_H
+#define INC_3D_TETRIS_RENDERSNAPSHOT_H
+
+#include "Board.h"
+#include "Tetromino.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace RenderUtil {
+    static constexpr unsigned int MAX_MESSAGES = 8;
+    static constexpr unsigned int MAX_MESSAGE_LENGTH = 80;
+
+    enum ViewRotation : uint8_t {
+        ROTATION_NONE  = 0,
+        ROTATION_LEFT  = 1, // Paused
+        ROTATION_RIGHT = 2, // Game over
+    };
+
+    struct Message {
+        int16_t x;
+        int16_t y;
+        float   scale;
+        char    text[MAX_MESSAGE_LENGTH];
+    };
+
+    // Everything the render thread needs to draw a frame, written by the simulation thread
+    // Nothing in here points back into the game, so it can be drawn while the game carries on
+    struct Snapshot {
+        uint32_t tick; // Ticks simulated before the snapshot
+        double tick_time; // glfwGetTime() when the last tick was due
+        BoardUtil::Cell cells[BoardUtil::NUM_CELLS];
+        TetrominoUtil::Pose previous; // The current tetromino before the last tick, to move it smoothly from
+        TetrominoUtil::Pose current;
+        TetrominoUtil::Pose ghost;
+        uint8_t draw_current; // The current tetromino is left out once it has landed
+        uint8_t rotation;     // ViewRotation
+
+        uint32_t input_sequence; // Bumped for each input whose latency is measured
+        double   input_time;     // When that input was received
+
+        uint8_t num_messages;
+        Message messages[MAX_MESSAGES];
+    };
+
+    inline void add_message(Snapshot& snapshot, int x, int y, float scale, const std::string& text) {
+        if (snapshot.num_messages >= MAX_MESSAGES) {
+            return;
+        }
+        Message& message = snapshot.messages[snapshot.num_messages++];
+        message.x = static_cast<int16_t>(x);
+        message.y = static_cast<int16_t>(y);
+        message.scale = scale;
+        size_t length = std::min(text.size(), static_cast<size_t>(MAX_MESSAGE_LENGTH - 1));
+        text.copy(message.text, length);
+        message.text[length] = '\0';
+    }
+}
+
+#endif //INC_3D_TETRIS_RENDERSNAPSHOT_H
@@ -0,0 +1,278 @@
+#include "Replay.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+
+// Replay writer
+// -------------
+
+ReplayWriter::ReplayWriter(const std::string& path, uint32_t keyframe_interval)
+        : file(path, std::ios::binary | std::ios::trunc),
+          interval(keyframe_interval)
+{
+    if (!file) {
+        throw std::runtime_error(std::string("fatal error: Failed to open replay for writing\nReplay path: ") + path);
+    }
+
+    ReplayUtil::Header header;
+    std::memcpy(header.magic, ReplayUtil::HEADER_MAGIC, sizeof(header.magic));
+    header.version = ReplayUtil::VERSION;
+    header.keyframe_interval = interval;
+    header.state_size = sizeof(SimulationUtil::State);
+    write(&header, sizeof(header));
+}
+
+ReplayWriter::~ReplayWriter() {
+    flush_idle_ticks();
+
+    ReplayUtil::Trailer trailer;
+    trailer.index_offset = offset;
+    trailer.index_count = static_cast<uint32_t>(index.size());
+    trailer.num_ticks = tick;
+    std::memcpy(trailer.magic, ReplayUtil::TRAILER_MAGIC, sizeof(trailer.magic));
+    trailer.padding = 0;
+
+    if (!index.empty()) {
+        write(index.data(), index.size() * sizeof(uint64_t));
+    }
+    write(&trailer, sizeof(trailer));
+}
+
+void ReplayWriter::begin_tick(const Simulation& simulation) {
+    bool regular_keyframe = (tick % interval == 0);
+    if (!regular_keyframe && !keyframe_forced) {
+        return;
+    }
+    keyframe_forced = false;
+
+    flush_idle_ticks();
+    if (regular_keyframe) {
+        index.push_back(offset);
+    }
+
+    SimulationUtil::State state = simulation.save_state();
+    uint8_t type = ReplayUtil::RECORD_KEYFRAME;
+    write(&type, sizeof(type));
+    write(&tick, sizeof(tick));
+    write(&state, sizeof(state));
+}
+
+void ReplayWriter::record_input(SimulationUtil::Input input) {
+    tick_inputs.push_back(static_cast<uint8_t>(input));
+}
+
+void ReplayWriter::end_tick() {
+    ++tick;
+
+    // Ticks without input are run length encoded
+    if (tick_inputs.empty()) {
+        ++idle_ticks;
+        return;
+    }
+    flush_idle_ticks();
+
+    // A tick can never take more inputs than the input queue holds, but clamp to be safe
+    uint8_t count = static_cast<uint8_t>(tick_inputs.size() > 255 ? 255 : tick_inputs.size());
+    uint8_t type = ReplayUtil::RECORD_TICK;
+    write(&type, sizeof(type));
+    write(&count, sizeof(count));
+    write(tick_inputs.data(), count);
+    tick_inputs.clear();
+}
+
+void ReplayWriter::write(const void* bytes, size_t size) {
+    file.write(static_cast<const char*>(bytes), size);
+    offset += size;
+}
+
+void ReplayWriter::flush_idle_ticks() {
+    if (idle_ticks == 0) {
+        return;
+    }
+
+    uint8_t record[1 + 5];
+    record[0] = ReplayUtil::RECORD_IDLE_TICKS;
+    size_t length = 1 + ReplayUtil::encode_varint(idle_ticks, &record[1]);
+    write(record, length);
+    idle_ticks = 0;
+}
+
+// Replay reader
+// -------------
+
+ReplayReader::ReplayReader(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error(std::string("fatal error: Failed to open replay\nReplay path: ") + path);
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 ||
+        file_stat.st_size < static_cast<off_t>(sizeof(ReplayUtil::Header) + sizeof(ReplayUtil::Trailer))) {
+        close(fd);
+        throw std::runtime_error(std::string("fatal error: Replay is truncated\nReplay path: ") + path);
+    }
+    size = static_cast<size_t>(file_stat.st_size);
+
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error(std::string("fatal error: Failed to map replay\nReplay path: ") + path);
+    }
+    data = static_cast<const uint8_t*>(mapping);
+
+    // Only the header and trailer are touched up front
+    std::memcpy(&header, data, sizeof(header));
+    std::memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+    if (std::memcmp(header.magic, ReplayUtil::HEADER_MAGIC, sizeof(header.magic)) != 0 ||
+        std::memcmp(trailer.magic, ReplayUtil::TRAILER_MAGIC, sizeof(trailer.magic)) != 0 ||
+        header.version != ReplayUtil::VERSION ||
+        header.state_size != sizeof(SimulationUtil::State) ||
+        trailer.index_count == 0 ||
+        trailer.index_offset + trailer.index_count * sizeof(uint64_t) > size - sizeof(trailer)) {
+        munmap(mapping, size);
+        throw std::runtime_error(std::string("fatal error: Replay is corrupt or from another version\nReplay path: ") + path);
+    }
+
+    // Every keyframe the index points at has to lie whole within the records, since seeking trusts them
+    for (uint32_t slot = 0; slot < trailer.index_count; ++slot) {
+        uint64_t keyframe_offset;
+        std::memcpy(&keyframe_offset, data + trailer.index_offset + slot * sizeof(uint64_t), sizeof(keyframe_offset));
+        if (keyframe_offset < sizeof(header) ||
+            keyframe_offset + KEYFRAME_RECORD_SIZE > trailer.index_offset ||
+            data[keyframe_offset] != ReplayUtil::RECORD_KEYFRAME) {
+            munmap(mapping, size);
+            throw std::runtime_error(std::string("fatal error: Replay is corrupt\nReplay path: ") + path);
+        }
+    }
+
+    cursor = sizeof(header); // Records start right after the header
+}
+
+ReplayReader::~ReplayReader() {
+    munmap(const_cast<uint8_t*>(data), size);
+}
+
+void ReplayReader::seek(Simulation& simulation, uint32_t target_tick) {
+    if (target_tick > trailer.num_ticks) {
+        target_tick = trailer.num_ticks;
+    }
+
+    // The index has one entry per interval, so finding the keyframe is a single lookup
+    uint32_t slot = target_tick / header.keyframe_interval;
+    if (slot >= trailer.index_count) {
+        slot = trailer.index_count - 1;
+    }
+    uint64_t keyframe_offset;
+    std::memcpy(&keyframe_offset, data + trailer.index_offset + slot * sizeof(uint64_t), sizeof(keyframe_offset));
+    load_keyframe(simulation, keyframe_offset);
+
+    while (tick < target_tick && step(simulation)) {
+    }
+}
+
+bool ReplayReader::step(Simulation& simulation) {
+    ReplayUtil::TickRecord record;
+    if (!read_tick(record)) {
+        return false;
+    }
+
+    // Keyframes in the middle of a run replace the state outright
+    if (record.has_keyframe) {
+        simulation.load_state(record.keyframe);
+    }
+    simulation.tick(record.inputs, record.num_inputs);
+    return true;
+}
+
+bool ReplayReader::read_tick(ReplayUtil::TickRecord& record) {
+    if (tick >= trailer.num_ticks) {
+        return false;
+    }
+
+    record.tick = tick;
+    record.has_keyframe = false;
+    record.num_inputs = 0;
+
+    // Carry on with a run of idle ticks
+    if (idle_ticks > 0) {
+        --idle_ticks;
+        ++tick;
+        return true;
+    }
+
+    while (cursor < trailer.index_offset) {
+        uint8_t type = data[cursor];
+        switch (type) {
+            case ReplayUtil::RECORD_KEYFRAME :
+                if (cursor + KEYFRAME_RECORD_SIZE > trailer.index_offset) {
+                    cursor = trailer.index_offset; // Cut short
+                    return false;
+                }
+                std::memcpy(&tick, data + cursor + 1, sizeof(tick));
+                std::memcpy(&record.keyframe, data + cursor + 1 + sizeof(tick), sizeof(record.keyframe));
+                cursor += 1 + sizeof(tick) + sizeof(record.keyframe);
+
+                record.tick = tick;
+                record.has_keyframe = true;
+                break;
+            case ReplayUtil::RECORD_TICK : {
+                if (cursor + 2 > trailer.index_offset || cursor + 2 + data[cursor + 1] > trailer.index_offset) {
+                    cursor = trailer.index_offset; // Cut short
+                    return false;
+                }
+                uint8_t count = data[cursor + 1];
+                for (uint8_t i = 0; i < count; ++i) {
+                    record.inputs[i] = static_cast<SimulationUtil::Input>(data[cursor + 2 + i]);
+                }
+                record.num_inputs = count;
+                cursor += 2 + count;
+
+                ++tick;
+                return true;
+            }
+            case ReplayUtil::RECORD_IDLE_TICKS : {
+                // Decode varint
+                uint32_t run = 0;
+                int shift = 0;
+                ++cursor;
+                while (cursor < trailer.index_offset) {
+                    uint8_t byte = data[cursor++];
+                    run |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                    shift += 7;
+                    if (!(byte & 0x80)) {
+                        break;
+                    }
+                }
+                if (run == 0) {
+                    break;
+                }
+
+                idle_ticks = run - 1;
+                ++tick;
+                return true;
+            }
+            default:
+                // Unknown record, nothing after it can be trusted
+                cursor = trailer.index_offset;
+                return false;
+        }
+    }
+
+    return false;
+}
+
+void ReplayReader::load_keyframe(Simulation& simulation, uint64_t keyframe_offset) {
+    SimulationUtil::State state;
+    std::memcpy(&tick, data + keyframe_offset + 1, sizeof(tick));
+    std::memcpy(&state, data + keyframe_offset + 1 + sizeof(tick), sizeof(state));
+    simulation.load_state(state);
+
+    cursor = keyframe_offset + KEYFRAME_RECORD_SIZE;
+    idle_ticks = 0;
+}
@@ -0,0 +1,140 @@
+#ifndef INC_3D_TETRIS_REPLAY_H
+#define INC_3D_TETRIS_REPLAY_H
+
+#include "Simulation.h"
+#include "Util/NonCopyable.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * Replay file layout
+ * ------------------
+ * Header
+ * Records, one after another:
+ *     RECORD_KEYFRAME   tick (u32), SimulationUtil::State
+ *     RECORD_TICK       input count (u8), inputs (u8 each)  - one tick with inputs
+ *     RECORD_IDLE_TICKS tick count (varint)                 - a run of ticks without inputs
+ * Index, one u64 file offset per keyframe interval, pointing at the keyframe for tick (i * interval)
+ * Trailer
+ *
+ * A keyframe is written every keyframe interval, and whenever the state jumps without a tick,
+ * such as on a reset. Seeking loads the keyframe for the interval and simulates the rest,
+ * so it never has to simulate more than one interval.
+ */
+namespace ReplayUtil {
+    static constexpr char HEADER_MAGIC[4]  = {'T', '3', 'D', 'R'};
+    static constexpr char TRAILER_MAGIC[4] = {'T', '3', 'D', 'I'};
+    static constexpr uint32_t VERSION = 1;
+
+    enum RecordType : uint8_t {
+        RECORD_KEYFRAME   = 1,
+        RECORD_TICK       = 2,
+        RECORD_IDLE_TICKS = 3,
+    };
+
+    struct Header {
+        char     magic[4];
+        uint32_t version;
+        uint32_t keyframe_interval;
+        uint32_t state_size; // sizeof(SimulationUtil::State), guards against layout changes
+    };
+
+    struct Trailer {
+        uint64_t index_offset;
+        uint32_t index_count;
+        uint32_t num_ticks;
+        char     magic[4];
+        uint32_t padding;
+    };
+
+    // One tick as it is stored in the file, before it is simulated
+    struct TickRecord {
+        uint32_t tick;
+        bool has_keyframe; // A keyframe was stored right before this tick
+        SimulationUtil::State keyframe;
+        uint8_t num_inputs;
+        SimulationUtil::Input inputs[255];
+    };
+
+    // Appends a LEB128 varint, returning the number of bytes written
+    inline size_t encode_varint(uint32_t value, uint8_t* out) {
+        size_t n = 0;
+        while (value >= 0x80) {
+            out[n++] = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        out[n++] = static_cast<uint8_t>(value);
+        return n;
+    }
+}
+
+// Writes a replay as the game is played
+class ReplayWriter : public Util::NonCopyable {
+public:
+    ReplayWriter(const std::string& path, uint32_t keyframe_interval);
+    ~ReplayWriter(); // Writes the index and trailer, so a replay cut short by a crash can not be read
+
+    // Called around every simulated tick
+    void begin_tick(const Simulation& simulation);
+    void record_input(SimulationUtil::Input input);
+    void end_tick();
+
+    // The next tick starts with a keyframe, for when the state changes outside of a tick
+    void force_keyframe() { keyframe_forced = true; }
+private:
+    void write(const void* data, size_t size);
+    void flush_idle_ticks();
+
+    std::ofstream file;
+    uint64_t offset = 0;
+
+    uint32_t interval;
+    uint32_t tick = 0;
+    uint32_t idle_ticks = 0;
+    bool keyframe_forced = true; // The first tick always has one
+
+    std::vector<uint8_t> tick_inputs;
+    std::vector<uint64_t> index;
+};
+
+// Plays back a replay, reading it through a memory mapping
+// Nothing is read from disk until a part of the file is touched
+class ReplayReader : public Util::NonCopyable {
+public:
+    explicit ReplayReader(const std::string& path);
+    ~ReplayReader();
+
+    // Loads the nearest keyframe before the tick and simulates up to it
+    void seek(Simulation& simulation, uint32_t target_tick);
+
+    // Plays one tick, returning false at the end of the replay
+    bool step(Simulation& simulation);
+
+    // Decodes one tick without simulating it, returning false at the end of the replay
+    bool read_tick(ReplayUtil::TickRecord& record);
+
+    // Getters
+    uint32_t get_num_ticks() const { return trailer.num_ticks; }
+    uint32_t get_current_tick() const { return tick; }
+private:
+    // Type, tick and state
+    static constexpr size_t KEYFRAME_RECORD_SIZE = 1 + sizeof(uint32_t) + sizeof(SimulationUtil::State);
+
+    void load_keyframe(Simulation& simulation, uint64_t keyframe_offset); // The offset must have been checked
+
+    const uint8_t* data;
+    size_t size;
+
+    ReplayUtil::Header header;
+    ReplayUtil::Trailer trailer;
+
+    uint64_t cursor = 0; // Offset of the next record
+    uint32_t tick = 0;   // Tick the next step will play
+    uint32_t idle_ticks = 0; // Remaining ticks in the current idle run
+};
+
+
+#endif //INC_3D_TETRIS_REPLAY_H
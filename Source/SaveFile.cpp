@@ -0,0 +1,92 @@
+#include "SaveFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef NDEBUG
+#include <iostream>
+#endif
+
+namespace {
+    uint32_t checksum(const SimulationUtil::State& state) {
+        // FNV-1a
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&state);
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < sizeof(state); ++i) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+}
+
+void SaveFile::save(const std::string& path, const SimulationUtil::State& state) {
+    SaveUtil::Record record;
+    std::memcpy(record.header.magic, SaveUtil::MAGIC, sizeof(record.header.magic));
+    record.header.version = SaveUtil::VERSION;
+    record.header.state_size = sizeof(SimulationUtil::State);
+    record.header.checksum = checksum(state);
+    record.state = state;
+
+    // No fsync, it alone can take longer than the budget for saving on pause
+    // The rename still means a crash can never leave a half written save behind
+    std::string temporary_path = path + ".tmp";
+    int fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        throw std::runtime_error(std::string("fatal error: Failed to open save file for writing\nSave path: ") + temporary_path);
+    }
+    ssize_t written = write(fd, &record, sizeof(record));
+    close(fd);
+    if (written != static_cast<ssize_t>(sizeof(record)) || rename(temporary_path.c_str(), path.c_str()) == -1) {
+        unlink(temporary_path.c_str());
+        throw std::runtime_error(std::string("fatal error: Failed to write save file\nSave path: ") + path);
+    }
+}
+
+bool SaveFile::load(const std::string& path, SimulationUtil::State& state) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || file_stat.st_size != static_cast<off_t>(sizeof(SaveUtil::Record))) {
+        close(fd);
+#ifndef NDEBUG
+        std::cerr << "Ignoring save file of the wrong size: " << path << "\n";
+#endif
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, sizeof(SaveUtil::Record), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    const SaveUtil::Record* record = static_cast<const SaveUtil::Record*>(mapping);
+    bool valid = std::memcmp(record->header.magic, SaveUtil::MAGIC, sizeof(record->header.magic)) == 0 &&
+                 record->header.version == SaveUtil::VERSION &&
+                 record->header.state_size == sizeof(SimulationUtil::State) &&
+                 record->header.checksum == checksum(record->state);
+    if (valid) {
+        state = record->state;
+    }
+#ifndef NDEBUG
+    else {
+        std::cerr << "Ignoring corrupt or outdated save file: " << path << "\n";
+    }
+#endif
+
+    munmap(mapping, sizeof(SaveUtil::Record));
+    return valid;
+}
+
+void SaveFile::remove(const std::string& path) {
+    unlink(path.c_str());
+}
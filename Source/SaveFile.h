@@ -0,0 +1,46 @@
+#ifndef INC_3D_TETRIS_SAVEFILE_H
+#define INC_3D_TETRIS_SAVEFILE_H
+
+#include "Simulation.h"
+
+#include <cstdint>
+#include <string>
+
+/*
+ * Save file layout
+ * ----------------
+ * A single fixed size record, so it is written with one write() and read in place:
+ *     SaveUtil::Header, then SimulationUtil::State
+ *
+ * The state holds the whole game, including the board, the active tetromino,
+ * the upcoming queue, the RNG, the score and the gravity timer.
+ */
+namespace SaveUtil {
+    static constexpr char MAGIC[4] = {'T', '3', 'D', 'S'};
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        char     magic[4];
+        uint32_t version;
+        uint32_t state_size; // sizeof(SimulationUtil::State), guards against layout changes
+        uint32_t checksum;   // Of the state, so a torn or corrupt save is never resumed
+    };
+
+    struct Record {
+        Header header;
+        SimulationUtil::State state;
+    };
+}
+
+namespace SaveFile {
+    // Writes to a temporary file then renames it over the save,
+    // so the save on disk is always either the old one or the new one
+    void save(const std::string& path, const SimulationUtil::State& state);
+
+    // Returns false if there is no save, or it is corrupt or from another version
+    bool load(const std::string& path, SimulationUtil::State& state);
+
+    void remove(const std::string& path);
+}
+
+#endif //INC_3D_TETRIS_SAVEFILE_H
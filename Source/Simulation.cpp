@@ -0,0 +1,271 @@
+#include "Simulation.h"
+
+#include <cstring>
+#include <random>
+
+bool SimulationUtil::is_valid_state(const State& state) {
+    using namespace TetrominoUtil;
+
+    const Pose& current = state.current;
+    if (current.type >= NUM_TYPES || current.rotation_state >= NUM_ROTATION_STATES ||
+        current.state > static_cast<uint8_t>(TetrominoState::LANDED)) {
+        return false;
+    }
+    for (uint8_t type : state.next_queue) {
+        if (type >= NUM_TYPES) {
+            return false;
+        }
+    }
+    for (BoardUtil::Cell cell : state.cells) {
+        if (cell > NUM_TYPES) { // Cells are types offset by one
+            return false;
+        }
+    }
+    return true;
+}
+
+Simulation::Simulation() :
+        current_tetromino(TetrominoUtil::TetrominoType::LINE, this)
+{
+    reset();
+}
+
+void Simulation::reset() {
+    reset(std::random_device()());
+}
+
+void Simulation::reset(uint32_t new_seed) {
+    rng_component.seed(new_seed);
+    seed = rng_component.get_state();
+
+    game_over = false;
+    score = 0;
+    lines_cleared = 0;
+    gravity_ticks = 0;
+
+    board.clear();
+    for (auto& type : next_queue) {
+        type = random_tetromino_type();
+    }
+    spawn_tetromino();
+}
+
+void Simulation::begin_tick() {
+    if (current_tetromino.get_state() == TetrominoUtil::TetrominoState::LANDED) {
+        spawn_tetromino();
+    }
+}
+
+bool Simulation::handle_input(SimulationUtil::Input input) {
+    switch (input) {
+        case SimulationUtil::Input::LEFT :
+            // Held keys keep pushing against the wall, which should not keep making a sound
+            if (current_tetromino.translate_left()) {
+                events |= SimulationUtil::EVENT_MOVED;
+            }
+            break;
+        case SimulationUtil::Input::RIGHT :
+            if (current_tetromino.translate_right()) {
+                events |= SimulationUtil::EVENT_MOVED;
+            }
+            break;
+        case SimulationUtil::Input::ROTATE :
+            current_tetromino.rotate_right();
+            events |= SimulationUtil::EVENT_MOVED;
+            break;
+        case SimulationUtil::Input::SOFT_DROP :
+            current_tetromino.translate_down(false);
+            events |= SimulationUtil::EVENT_MOVED;
+
+            // Reset move time
+            gravity_ticks = 0;
+            break;
+        case SimulationUtil::Input::HARD_DROP :
+            current_tetromino.jump_down(false);
+            events |= SimulationUtil::EVENT_MOVED;
+            return false; // Skip rest of tick, because last translate down is redundant
+        default:
+            break;
+    }
+
+    return true;
+}
+
+void Simulation::end_tick() {
+    // Move down current tetromino if enough ticks passed
+    if (++gravity_ticks >= TICKS_BETWEEN_TETROMINO_MOVEMENTS) {
+        current_tetromino.translate_down(false);
+        gravity_ticks = 0;
+    }
+}
+
+void Simulation::tick(const SimulationUtil::Input* inputs, size_t num_inputs) {
+    if (game_over) {
+        return;
+    }
+
+    begin_tick();
+    for (size_t i = 0; i < num_inputs; ++i) {
+        if (!handle_input(inputs[i])) {
+            return;
+        }
+    }
+    end_tick();
+}
+
+void Simulation::add_landed(const Tetromino& tetromino) {
+    BoardUtil::Cell cell = BoardUtil::cell_from_type(tetromino.get_type());
+    for (auto& block : tetromino.get_blocks()) {
+        board.set(block, cell);
+    }
+    events |= SimulationUtil::EVENT_LANDED;
+
+    if (tetromino.highest_block() <= 1) {
+        game_over = true;
+        events |= SimulationUtil::EVENT_GAME_OVER;
+    }
+
+    handle_row_clearing();
+}
+
+void Simulation::add_garbage(unsigned int rows) {
+    if (game_over || rows == 0) {
+        return;
+    }
+
+    // The hole comes from this simulation's generator, so every peer puts it in the same place
+    unsigned int hole = static_cast<unsigned int>(rng_component.rng(0, GAME_WIDTH - 1));
+    bool overflowed = !board.insert_garbage(rows, hole);
+
+    // Lift the falling tetromino clear of the new rows
+    if (current_tetromino.get_state() != TetrominoUtil::TetrominoState::LANDED) {
+        for (unsigned int lifted = 0; lifted < rows && check_collision(current_tetromino); ++lifted) {
+            TetrominoUtil::Pose pose = current_tetromino.get_pose();
+            --pose.top_left[1];
+            for (auto& block : pose.blocks) {
+                --block[1];
+            }
+            current_tetromino = Tetromino(pose, this);
+        }
+    }
+
+    if (overflowed) {
+        game_over = true;
+        events |= SimulationUtil::EVENT_GAME_OVER;
+    }
+}
+
+bool Simulation::check_collision(const Tetromino& new_pos) const {
+    for (auto& block : new_pos.get_blocks()) {
+        if (board.occupied(block)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+SimulationUtil::State Simulation::save_state() const {
+    SimulationUtil::State state;
+    std::memset(&state, 0, sizeof(state)); // Padding too, so equal states compare and store equal
+    std::memcpy(state.cells, board.data(), Board::size_in_bytes());
+    state.current = current_tetromino.get_pose();
+    for (unsigned int i = 0; i < NEXT_QUEUE_SIZE; ++i) {
+        state.next_queue[i] = static_cast<uint8_t>(next_queue[i]);
+    }
+    state.game_over = game_over;
+    state.gravity_ticks = static_cast<uint16_t>(gravity_ticks);
+    state.rng_state = rng_component.get_state();
+    state.seed = seed;
+    state.score = score;
+    state.lines_cleared = lines_cleared;
+    return state;
+}
+
+void Simulation::load_state(const SimulationUtil::State& state) {
+    board.load(state.cells);
+    current_tetromino = Tetromino(state.current, this);
+    for (unsigned int i = 0; i < NEXT_QUEUE_SIZE; ++i) {
+        next_queue[i] = static_cast<TetrominoUtil::TetrominoType>(state.next_queue[i]);
+    }
+    game_over = (state.game_over != 0);
+    gravity_ticks = state.gravity_ticks;
+    rng_component.set_state(state.rng_state);
+    seed = state.seed;
+    score = state.score;
+    lines_cleared = state.lines_cleared;
+
+    events = 0; // Whatever happened before belongs to another state
+}
+
+uint32_t Simulation::consume_events() {
+    uint32_t consumed = events;
+    events = 0;
+    return consumed;
+}
+
+Tetromino Simulation::get_ghost_tetromino() const {
+    // The ghost only ever checks for collisions, so it is safe to bind it to a const simulation
+    Tetromino ghost = current_tetromino;
+    ghost.jump_down(true);
+    return ghost;
+}
+
+void Simulation::handle_row_clearing() {
+    // Get estimate for how high to check
+    int row_clearing_cap = board.highest_occupied_row();
+
+    // Row clearing
+    // -----------
+    // Removing a row moves every row above it down,
+    // so the same row is checked again after a clear
+    int rows_cleared = 0;
+    for (int y = GAME_HEIGHT - 1; y >= row_clearing_cap;) {
+        if (board.row_full(y)) {
+            board.remove_row(y);
+            ++row_clearing_cap;
+            ++rows_cleared;
+        } else {
+            --y;
+        }
+    }
+    lines_cleared += rows_cleared;
+
+
+    // Scoring
+    // ------
+
+    // Lookup table which matches the rows cleared with the score to be awarded
+    static const int ROWS_CLEARED_SCORING_TABLE[4] = {
+            40,
+            100,
+            300,
+            1200,
+    };
+    if (rows_cleared >= 1 && rows_cleared <= 4) {
+        score += ROWS_CLEARED_SCORING_TABLE[rows_cleared - 1];
+    }
+
+    // Flag sound according to how many rows were cleared
+    if (rows_cleared >= 4) {
+        events |= SimulationUtil::EVENT_TETRIS;
+    } else if (rows_cleared >= 1 && rows_cleared < 4) {
+        events |= SimulationUtil::EVENT_LINE_CLEAR;
+    }
+}
+
+void Simulation::spawn_tetromino() {
+    current_tetromino = Tetromino(next_queue[0], this);
+
+    // Shift the queue along and fill in the back
+    for (unsigned int i = 1; i < NEXT_QUEUE_SIZE; ++i) {
+        next_queue[i - 1] = next_queue[i];
+    }
+    next_queue[NEXT_QUEUE_SIZE - 1] = random_tetromino_type();
+
+    events |= SimulationUtil::EVENT_SPAWNED;
+}
+
+TetrominoUtil::TetrominoType Simulation::random_tetromino_type() {
+    return static_cast<TetrominoUtil::TetrominoType>(rng_component.rng(0, 6));
+}
@@ -0,0 +1,117 @@
+#ifndef INC_3D_TETRIS_SIMULATION_H
+#define INC_3D_TETRIS_SIMULATION_H
+
+#include "Tetromino.h"
+#include "Board.h"
+#include "Constants.h"
+#include "RandomNumberComponent.h"
+#include "Util/NonCopyable.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace SimulationUtil {
+    // Moves the simulation understands, independent of where they came from
+    enum class Input : uint8_t {
+        NONE      = 0,
+        LEFT      = 1,
+        RIGHT     = 2,
+        ROTATE    = 3,
+        SOFT_DROP = 4,
+        HARD_DROP = 5,
+    };
+    static constexpr uint8_t NUM_INPUTS = 6;
+
+    // Things which happened since the events were last consumed
+    enum Event : uint32_t {
+        EVENT_MOVED      = 1u << 0,
+        EVENT_LINE_CLEAR = 1u << 1,
+        EVENT_TETRIS     = 1u << 2,
+        EVENT_SPAWNED    = 1u << 3,
+        EVENT_LANDED     = 1u << 4,
+        EVENT_GAME_OVER  = 1u << 5,
+    };
+
+    // The complete simulation state
+    // Trivially copyable, so it can be saved and restored byte for byte
+    struct State {
+        uint8_t  cells[BoardUtil::NUM_CELLS];
+        TetrominoUtil::Pose current;
+        uint8_t  next_queue[NEXT_QUEUE_SIZE];
+        uint8_t  game_over;
+        uint16_t gravity_ticks;
+        uint32_t rng_state;
+        uint32_t seed;      // The game is identified by the seed it was started from
+        uint32_t score;
+        uint32_t lines_cleared;
+    };
+    static_assert(std::is_trivially_copyable<State>::value, "Simulation state must be copyable byte for byte");
+
+    // False for a state which load_state() would turn into out of range types, rotations or cells
+    // Anything read from outside the process has to pass this first
+    bool is_valid_state(const State& state);
+}
+
+// The game rules, stepped one fixed tick at a time
+// Does not touch the window, the clock or audio, so the same inputs on the same state
+// always produce the same result. This is what lets replays be resimulated.
+class Simulation : public Util::NonCopyable {
+public:
+    Simulation();
+
+    void reset(); // Starts a new game from a random seed
+    void reset(uint32_t new_seed); // Same seed, same game
+
+    // A tick is begin_tick(), any number of inputs, then end_tick()
+    void begin_tick();
+    bool handle_input(SimulationUtil::Input input); // Returns false if the rest of the tick should be skipped
+    void end_tick();
+    void tick(const SimulationUtil::Input* inputs, size_t num_inputs);
+
+    // Pushes rows of garbage in from the bottom, for versus
+    void add_garbage(unsigned int rows);
+
+    // Used by the tetrominos
+    void add_landed(const Tetromino& tetromino);
+    bool check_collision(const Tetromino& new_pos) const;
+
+    SimulationUtil::State save_state() const;
+    void load_state(const SimulationUtil::State& state);
+
+    uint32_t consume_events(); // Returns and clears SimulationUtil::Event flags
+
+    // Getters
+    const Board& get_board() const { return board; }
+    const Tetromino& get_current_tetromino() const { return current_tetromino; }
+    Tetromino get_ghost_tetromino() const; // Where the current tetromino would land
+    const std::array<TetrominoUtil::TetrominoType, NEXT_QUEUE_SIZE>& get_next_queue() const { return next_queue; }
+    bool is_game_over() const { return game_over; }
+    uint32_t get_seed() const { return seed; }
+    unsigned int get_score() const { return score; }
+    unsigned int get_lines_cleared() const { return lines_cleared; }
+private:
+    void handle_row_clearing();
+    void spawn_tetromino();
+    TetrominoUtil::TetrominoType random_tetromino_type();
+
+    RandomNumberComponent rng_component;
+
+    Tetromino current_tetromino;
+    std::array<TetrominoUtil::TetrominoType, NEXT_QUEUE_SIZE> next_queue;
+    Board board;
+
+    uint32_t seed = 0;
+    bool game_over = false;
+    unsigned int score = 0;
+    unsigned int lines_cleared = 0;
+
+    // Ticks since the current tetromino last moved down
+    unsigned int gravity_ticks = 0;
+
+    uint32_t events = 0;
+};
+
+
+#endif //INC_3D_TETRIS_SIMULATION_H
@@ -0,0 +1,201 @@
+#include "SpectatorLink.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+SpectatorServer::SpectatorServer(uint16_t port) {
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        throw std::runtime_error("fatal error: Failed to create spectator socket");
+    }
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 ||
+        listen(listen_fd, 16) == -1) {
+        close(listen_fd);
+        throw std::runtime_error("fatal error: Failed to listen for spectators\nPort: " + std::to_string(port));
+    }
+}
+
+SpectatorServer::~SpectatorServer() {
+    for (Spectator& spectator : spectators) {
+        close(spectator.fd);
+    }
+    close(listen_fd);
+}
+
+uint16_t SpectatorServer::get_port() const {
+    sockaddr_in address;
+    socklen_t address_size = sizeof(address);
+    if (getsockname(listen_fd, reinterpret_cast<sockaddr*>(&address), &address_size) == -1) {
+        return 0;
+    }
+    return ntohs(address.sin_port);
+}
+
+void SpectatorServer::publish(const SimulationUtil::State& state) {
+    // Everyone already watching has the last state, so they only need the delta
+    if (!spectators.empty()) {
+        frame.clear();
+        encoder.encode_delta(state, frame);
+        for (size_t i = 0; i < spectators.size();) {
+            if (send_to(spectators[i], frame.data(), frame.size())) {
+                ++i;
+            } else {
+                close(spectators[i].fd);
+                spectators.erase(spectators.begin() + i);
+            }
+        }
+    }
+
+    accept_spectators(state);
+}
+
+void SpectatorServer::accept_spectators(const SimulationUtil::State& state) {
+    while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            return;
+        }
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+        // Also moves the encoder on to this state, which everyone else already has
+        frame.clear();
+        encoder.encode_keyframe(state, frame);
+
+        Spectator spectator;
+        spectator.fd = fd;
+        if (send_to(spectator, frame.data(), frame.size())) {
+            spectators.push_back(std::move(spectator));
+        } else {
+            close(fd);
+        }
+    }
+}
+
+bool SpectatorServer::send_to(Spectator& spectator, const uint8_t* data, size_t size) {
+    spectator.output.insert(spectator.output.end(), data, data + size);
+    if (spectator.output.size() > SpectatorLinkUtil::MAX_PENDING_OUTPUT) {
+        return false;
+    }
+
+    size_t sent_total = 0;
+    while (sent_total < spectator.output.size()) {
+        ssize_t sent = send(spectator.fd, spectator.output.data() + sent_total, spectator.output.size() - sent_total,
+                            MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        sent_total += static_cast<size_t>(sent);
+    }
+    spectator.output.erase(spectator.output.begin(), spectator.output.begin() + sent_total);
+    return true;
+}
+
+SpectatorClient::SpectatorClient(const std::string& host, uint16_t port) : stats_start(Clock::now()) {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0 || result == nullptr) {
+        throw std::runtime_error(std::string("fatal error: Failed to resolve game to spectate\nHost: ") + host);
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1 || connect(fd, result->ai_addr, result->ai_addrlen) == -1) {
+        freeaddrinfo(result);
+        if (fd != -1) {
+            close(fd);
+        }
+        throw std::runtime_error("fatal error: Failed to connect to game to spectate\nHost: " + host +
+                                 "\nPort: " + std::to_string(port));
+    }
+    freeaddrinfo(result);
+
+    // Connecting blocks, reading never does
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+SpectatorClient::~SpectatorClient() {
+    disconnect();
+}
+
+bool SpectatorClient::poll() {
+    if (fd == -1) {
+        return false;
+    }
+
+    uint8_t buffer[4096];
+    while (true) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            disconnect();
+            break;
+        }
+        if (received < 0) {
+            break;
+        }
+        input.insert(input.end(), buffer, buffer + received);
+        stats_bytes += static_cast<uint64_t>(received);
+    }
+
+    // Decode every whole frame
+    size_t offset = 0;
+    while (input.size() - offset >= sizeof(SpectatorUtil::FrameSize)) {
+        SpectatorUtil::FrameSize size;
+        std::memcpy(&size, &input[offset], sizeof(size));
+        if (input.size() - offset - sizeof(size) < size) {
+            break;
+        }
+
+        Clock::time_point decode_start = Clock::now();
+        bool decoded = decoder.decode(&input[offset + sizeof(size)], size);
+        stats_decode_seconds += std::chrono::duration<double>(Clock::now() - decode_start).count();
+        ++stats_frames;
+
+        offset += sizeof(size) + size;
+        if (!decoded) {
+            disconnect(); // Nothing after a bad frame can be trusted
+            break;
+        }
+    }
+    input.erase(input.begin(), input.begin() + offset);
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - stats_start).count();
+    if (elapsed >= SpectatorLinkUtil::STATS_INTERVAL) {
+        bytes_per_second = stats_bytes / elapsed;
+        decode_microseconds = stats_frames != 0 ? stats_decode_seconds * 1000000.0 / stats_frames : 0.0;
+        stats_start = Clock::now();
+        stats_bytes = stats_frames = 0;
+        stats_decode_seconds = 0.0;
+    }
+
+    return fd != -1;
+}
+
+void SpectatorClient::disconnect() {
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef INC_3D_TETRIS_SPECTATORLINK_H
+#define INC_3D_TETRIS_SPECTATORLINK_H
+
+#include "SpectatorStream.h"
+#include "Util/NonCopyable.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SpectatorLinkUtil {
+    static constexpr size_t MAX_PENDING_OUTPUT = 64 * 1024; // Spectators further behind than this are dropped
+    static constexpr double STATS_INTERVAL = 1.0; // Seconds the client's stats are averaged over
+}
+
+// Streams the game to spectators connecting over TCP
+// Polled once per tick from the game loop, so it never blocks
+class SpectatorServer : public Util::NonCopyable {
+public:
+    explicit SpectatorServer(uint16_t port);
+    ~SpectatorServer();
+
+    // Sends the state after a tick to everyone watching, new spectators get a keyframe of it
+    void publish(const SimulationUtil::State& state);
+
+    size_t get_num_spectators() const { return spectators.size(); }
+    uint16_t get_port() const; // The one actually bound, for servers started on port 0
+private:
+    struct Spectator {
+        int fd;
+        std::vector<uint8_t> output; // Not yet accepted by the socket
+    };
+
+    void accept_spectators(const SimulationUtil::State& state);
+    bool send_to(Spectator& spectator, const uint8_t* data, size_t size); // Returns false if they were dropped
+
+    int listen_fd;
+    std::vector<Spectator> spectators;
+    SpectatorEncoder encoder;
+    std::vector<uint8_t> frame;
+};
+
+// Watches a game streamed by a SpectatorServer
+class SpectatorClient : public Util::NonCopyable {
+public:
+    SpectatorClient(const std::string& host, uint16_t port);
+    ~SpectatorClient();
+
+    // Decodes every frame which has arrived, returns false once the stream has ended
+    bool poll();
+
+    // Getters
+    bool is_connected() const { return fd != -1; }
+    const Simulation& get_simulation() const { return decoder.get_simulation(); }
+    bool has_keyframe() const { return decoder.has_keyframe(); }
+    double get_bytes_per_second() const { return bytes_per_second; }
+    double get_decode_microseconds() const { return decode_microseconds; } // Mean per frame
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void disconnect();
+
+    int fd;
+    SpectatorDecoder decoder;
+    std::vector<uint8_t> input; // Received but not yet a whole frame
+
+    // Stats, updated every SpectatorLinkUtil::STATS_INTERVAL
+    Clock::time_point stats_start;
+    uint64_t stats_bytes = 0;
+    uint64_t stats_frames = 0;
+    double stats_decode_seconds = 0.0;
+    double bytes_per_second = 0.0;
+    double decode_microseconds = 0.0;
+};
+
+
+#endif //INC_3D_TETRIS_SPECTATORLINK_H
@@ -0,0 +1,185 @@
+#include "SpectatorStream.h"
+
+#include <cstring>
+
+namespace {
+    template <typename T>
+    void put(std::vector<uint8_t>& out, const T& value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    // Reads from a frame without ever going past its end
+    class FrameReader {
+    public:
+        FrameReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+        template <typename T>
+        bool get(T& value) {
+            if (offset + sizeof(T) > size) {
+                return false;
+            }
+            std::memcpy(&value, data + offset, sizeof(T));
+            offset += sizeof(T);
+            return true;
+        }
+
+        bool at_end() const { return offset == size; }
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t offset = 0;
+    };
+
+    const BoardUtil::Cell* row_of(const SimulationUtil::State& state, unsigned int y) {
+        return state.cells + y * GAME_WIDTH;
+    }
+}
+
+void SpectatorEncoder::encode_keyframe(const SimulationUtil::State& state, std::vector<uint8_t>& out) {
+    put(out, static_cast<SpectatorUtil::FrameSize>(1 + sizeof(state)));
+    put(out, static_cast<uint8_t>(SpectatorUtil::FLAG_KEYFRAME));
+    put(out, state);
+
+    previous = state;
+    previous_valid = true;
+}
+
+void SpectatorEncoder::encode_delta(const SimulationUtil::State& state, std::vector<uint8_t>& out) {
+    using namespace SpectatorUtil;
+
+    if (!previous_valid) {
+        encode_keyframe(state, out);
+        return;
+    }
+
+    // The size and flags are filled in once the rest is known
+    size_t start = out.size();
+    put(out, static_cast<FrameSize>(0));
+    put(out, static_cast<uint8_t>(0));
+    uint8_t flags = state.game_over ? FLAG_GAME_OVER : 0;
+
+    uint32_t row_mask = 0;
+    for (unsigned int y = 0; y < GAME_HEIGHT; ++y) {
+        if (std::memcmp(row_of(state, y), row_of(previous, y), GAME_WIDTH) != 0) {
+            row_mask |= 1u << y;
+        }
+    }
+    if (row_mask != 0) {
+        flags |= FLAG_ROWS;
+        put(out, row_mask);
+        for (unsigned int y = 0; y < GAME_HEIGHT; ++y) {
+            if (!(row_mask & (1u << y))) {
+                continue;
+            }
+            const BoardUtil::Cell* row = row_of(state, y);
+            uint16_t cell_mask = 0;
+            for (unsigned int x = 0; x < GAME_WIDTH; ++x) {
+                if (row[x] != BoardUtil::EMPTY_CELL) {
+                    cell_mask |= 1u << x;
+                }
+            }
+            put(out, cell_mask);
+            for (unsigned int x = 0; x < GAME_WIDTH; ++x) {
+                if (row[x] != BoardUtil::EMPTY_CELL) {
+                    put(out, row[x]);
+                }
+            }
+        }
+    }
+
+    if (std::memcmp(&state.current, &previous.current, sizeof(state.current)) != 0) {
+        flags |= FLAG_POSE;
+        put(out, state.current);
+    }
+    if (state.score != previous.score || state.lines_cleared != previous.lines_cleared) {
+        flags |= FLAG_SCORE;
+        put(out, state.score);
+        put(out, state.lines_cleared);
+    }
+    if (std::memcmp(state.next_queue, previous.next_queue, sizeof(state.next_queue)) != 0) {
+        flags |= FLAG_NEXT;
+        put(out, state.next_queue);
+    }
+
+    FrameSize size = static_cast<FrameSize>(out.size() - start - sizeof(FrameSize));
+    std::memcpy(&out[start], &size, sizeof(size));
+    out[start + sizeof(FrameSize)] = flags;
+
+    previous = state;
+}
+
+SpectatorDecoder::SpectatorDecoder() {
+    state = view.save_state();
+}
+
+bool SpectatorDecoder::decode(const uint8_t* frame, size_t size) {
+    using namespace SpectatorUtil;
+
+    FrameReader reader(frame, size);
+    uint8_t flags;
+    if (!reader.get(flags)) {
+        return false;
+    }
+
+    if (flags & FLAG_KEYFRAME) {
+        SimulationUtil::State keyframe;
+        if (!reader.get(keyframe) || !reader.at_end() || !SimulationUtil::is_valid_state(keyframe)) {
+            return false;
+        }
+        state = keyframe;
+        keyframe_seen = true;
+        view.load_state(state);
+        return true;
+    }
+    if (!keyframe_seen) {
+        return true;
+    }
+
+    // Work on a copy, so a bad frame leaves the last good state alone
+    SimulationUtil::State next = state;
+    next.game_over = (flags & FLAG_GAME_OVER) ? 1 : 0;
+
+    if (flags & FLAG_ROWS) {
+        uint32_t row_mask;
+        if (!reader.get(row_mask)) {
+            return false;
+        }
+        for (unsigned int y = 0; y < GAME_HEIGHT; ++y) {
+            if (!(row_mask & (1u << y))) {
+                continue;
+            }
+            uint16_t cell_mask;
+            if (!reader.get(cell_mask)) {
+                return false;
+            }
+            BoardUtil::Cell* row = next.cells + y * GAME_WIDTH;
+            for (unsigned int x = 0; x < GAME_WIDTH; ++x) {
+                row[x] = BoardUtil::EMPTY_CELL;
+                if ((cell_mask & (1u << x)) && !reader.get(row[x])) {
+                    return false;
+                }
+            }
+        }
+    }
+    if ((flags & FLAG_POSE) && !reader.get(next.current)) {
+        return false;
+    }
+    if ((flags & FLAG_SCORE) && !(reader.get(next.score) && reader.get(next.lines_cleared))) {
+        return false;
+    }
+    if ((flags & FLAG_NEXT) && !reader.get(next.next_queue)) {
+        return false;
+    }
+    if (!reader.at_end() || !SimulationUtil::is_valid_state(next)) {
+        return false;
+    }
+
+    // Most ticks change nothing, and rebuilding the view is the expensive part
+    bool changed = (flags & (FLAG_ROWS | FLAG_POSE | FLAG_SCORE | FLAG_NEXT)) || next.game_over != state.game_over;
+    state = next;
+    if (changed) {
+        view.load_state(state);
+    }
+    return true;
+}
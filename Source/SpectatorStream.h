@@ -0,0 +1,77 @@
+#ifndef INC_3D_TETRIS_SPECTATORSTREAM_H
+#define INC_3D_TETRIS_SPECTATORSTREAM_H
+
+#include "Simulation.h"
+#include "Util/NonCopyable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Spectator stream format
+ * -----------------------
+ * A stream is a sequence of frames, each prefixed by its size as a uint16_t.
+ * The first frame a spectator gets is a keyframe holding a whole SimulationUtil::State.
+ * Every tick after that is one delta frame holding only what changed since the last tick:
+ *
+ *   uint8_t flags                       (FrameFlag)
+ *   FLAG_ROWS:  uint32_t row mask       one bit per changed row
+ *               per changed row: uint16_t mask of occupied cells, then one cell per occupied cell
+ *   FLAG_POSE:  TetrominoUtil::Pose     the current tetromino
+ *   FLAG_SCORE: uint32_t score, uint32_t lines cleared
+ *   FLAG_NEXT:  one type per NEXT_QUEUE_SIZE
+ *
+ * A tick where nothing moved is the flags byte alone, three bytes with the size prefix.
+ * Frames holding types, rotations or cells out of range are rejected as malformed.
+ */
+namespace SpectatorUtil {
+    enum FrameFlag : uint8_t {
+        FLAG_KEYFRAME  = 1u << 0, // Followed by a whole state and nothing else
+        FLAG_ROWS      = 1u << 1,
+        FLAG_POSE      = 1u << 2,
+        FLAG_SCORE     = 1u << 3,
+        FLAG_NEXT      = 1u << 4,
+        FLAG_GAME_OVER = 1u << 5, // Sent every frame, the value rather than a change
+    };
+
+    using FrameSize = uint16_t;
+    static constexpr size_t MAX_FRAME_SIZE = 1 + sizeof(SimulationUtil::State) + 64; // Bigger than any frame
+
+    static_assert(GAME_HEIGHT <= 32, "Row mask must fit every row");
+    static_assert(GAME_WIDTH <= 16, "Cell mask must fit every column");
+}
+
+// Turns the state after each tick into frames
+class SpectatorEncoder {
+public:
+    // Both append a whole frame, size prefix included
+    void encode_keyframe(const SimulationUtil::State& state, std::vector<uint8_t>& out);
+    void encode_delta(const SimulationUtil::State& state, std::vector<uint8_t>& out); // Against the last frame
+
+    bool has_previous() const { return previous_valid; }
+private:
+    SimulationUtil::State previous;
+    bool previous_valid = false;
+};
+
+// Rebuilds a simulation to draw from frames
+// Only what can be seen is streamed, so the rebuilt simulation is for drawing and must not be ticked
+class SpectatorDecoder : public Util::NonCopyable {
+public:
+    SpectatorDecoder();
+
+    // Takes one frame without its size prefix, returns false if it is malformed
+    // Deltas before the first keyframe are skipped
+    bool decode(const uint8_t* frame, size_t size);
+
+    bool has_keyframe() const { return keyframe_seen; }
+    const Simulation& get_simulation() const { return view; }
+private:
+    SimulationUtil::State state;
+    bool keyframe_seen = false;
+    Simulation view;
+};
+
+
+#endif //INC_3D_TETRIS_SPECTATORSTREAM_H
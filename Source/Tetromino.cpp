@@ -5,9 +5,10 @@
 #include "Tetromino.h"
 
 #include "Constants.h"
-#include "Game.h"
+#include "Simulation.h"
 
 #include <array>
+#include <stdexcept>
 
 #ifndef NDEBUG
 #include <iostream>
@@ -100,11 +101,11 @@ const uint32_t Tetromino::possible_colors[TetrominoUtil::NUM_POSSIBLE_COLOURS] =
         0xFFFFFF, // White
 };
 
-Tetromino::Tetromino(TetrominoUtil::TetrominoType type, Game* game)
+Tetromino::Tetromino(TetrominoUtil::TetrominoType type, Simulation* simulation)
         : tetromino_type(type),
           tetromino_state(TetrominoUtil::TetrominoState::MOVING),
           rotation_state(0),
-          bound_game(game),
+          bound_simulation(simulation),
           color(possible_colors[static_cast<int>(tetromino_type)])
 {
 
@@ -125,6 +126,36 @@ Tetromino::Tetromino(TetrominoUtil::TetrominoType type, Game* game)
     }
 }
 
+Tetromino::Tetromino(const TetrominoUtil::Pose& pose, Simulation* simulation)
+        : rotation_state(pose.rotation_state),
+          bound_simulation(simulation),
+          top_left_point(pose.top_left[0], pose.top_left[1]),
+          tetromino_type(static_cast<TetrominoUtil::TetrominoType>(pose.type)),
+          tetromino_state(static_cast<TetrominoUtil::TetrominoState>(pose.state)),
+          color(possible_colors[pose.type])
+{
+    for (int i = 0; i < TetrominoUtil::BLOCKS_IN_TETROMINO; ++i) {
+        blocks.insert(ivec2{pose.blocks[i][0], pose.blocks[i][1]});
+    }
+}
+
+TetrominoUtil::Pose Tetromino::get_pose() const {
+    TetrominoUtil::Pose pose;
+    pose.type = static_cast<uint8_t>(tetromino_type);
+    pose.rotation_state = static_cast<uint8_t>(rotation_state);
+    pose.state = static_cast<uint8_t>(tetromino_state);
+    pose.top_left[0] = static_cast<int8_t>(top_left_point.x);
+    pose.top_left[1] = static_cast<int8_t>(top_left_point.y);
+
+    int i = 0;
+    for (auto& b : blocks) {
+        pose.blocks[i][0] = static_cast<int8_t>(b.x);
+        pose.blocks[i][1] = static_cast<int8_t>(b.y);
+        ++i;
+    }
+    return pose;
+}
+
 bool Tetromino::translate_left() {
     if (tetromino_state == TetrominoUtil::TetrominoState::LANDED) {
         return false; // End function if the tetromino has landed
@@ -147,7 +178,7 @@ bool Tetromino::translate_left() {
         blocks.insert(ivec2{old_iter->x - 1, old_iter->y});
     }
 
-    if (!bound_game->check_collision(*this)) {
+    if (!bound_simulation->check_collision(*this)) {
         top_left_point.x -= 1;      // Translate the top left point
                                     // because it is ok to translate
         return true;
@@ -178,7 +209,7 @@ bool Tetromino::translate_right() {
         blocks.insert(ivec2{old_iter->x + 1, old_iter->y});
     }
 
-    if (!bound_game->check_collision(*this)) {
+    if (!bound_simulation->check_collision(*this)) {
         top_left_point.x += 1;      // Translate the top left point
                                     // because it is ok to translate
         return true;
@@ -219,7 +250,7 @@ bool Tetromino::translate_down(bool is_ghost) {
         blocks.insert(ivec2{old_iter->x, old_iter->y + 1});
     }
 
-    if (!bound_game->check_collision(*this)) {
+    if (!bound_simulation->check_collision(*this)) {
         top_left_point.y += 1;      // Translate the top left point
                                     // because it is ok to translate
         return true;
@@ -237,28 +268,6 @@ bool Tetromino::translate_down(bool is_ghost) {
     }
 }
 
-void Tetromino::translate_blocks_down(const std::vector<glm::ivec2> &blocks_to_move, int y_translation_factor) {
-    std::set<glm::ivec2, TetrominoUtil::CompareIvec2> old_blocks = blocks; // Store blocks before translation
-
-    blocks.clear();
-    for (auto& b : blocks_to_move) {
-        blocks.insert(ivec2{b.x, b.y + y_translation_factor});
-    }
-    for (auto& old_b : old_blocks) {
-        bool not_translated_block = true;
-        for (auto& b : blocks_to_move) {
-            if (old_b.x == b.x && old_b.y == b.y) {
-                not_translated_block = false;
-            }
-        }
-
-        if (not_translated_block) {
-            blocks.insert(old_b);
-        }
-    }
-
-}
-
 void Tetromino::jump_down(bool ghost_tetromino) {
     while (tetromino_state != TetrominoUtil::TetrominoState::LANDED) {
         translate_down(ghost_tetromino);
@@ -290,7 +299,7 @@ void Tetromino::rotate_left() {
         blocks.insert(relative_coords[i]);
     }
 
-    if (!bound_game->check_collision(*this)) {
+    if (!bound_simulation->check_collision(*this)) {
         // Wall kick
         for (int i = 0; i < TetrominoUtil::BLOCKS_IN_TETROMINO; ++i) {
             if (relative_coords[i].x < 0) {
@@ -333,7 +342,7 @@ void Tetromino::rotate_right() {
         blocks.insert(relative_coords[i]);
     }
 
-    if (!bound_game->check_collision(*this)) {
+    if (!bound_simulation->check_collision(*this)) {
         // Wall kick
         for (auto& b : blocks) {
             if (b.x < 0) {
@@ -351,52 +360,16 @@ void Tetromino::rotate_right() {
     }
 }
 
-bool Tetromino::block_exists(const glm::ivec2 &block) {
-    return blocks.find(block) != blocks.end();
-}
-
-void Tetromino::remove_block(const glm::ivec2 &block) {
-    if (tetromino_state != TetrominoUtil::TetrominoState::LANDED) {
-#ifndef NDEBUG
-        std::cerr << "error: Trying to remove block from tetromino that has not landed yet\n";
-#endif
-    }
-
-    blocks.erase(block);
-}
-
-void Tetromino::remove_blocks(const std::vector<glm::ivec2>& blocks_to_remove) {
-    if (tetromino_state != TetrominoUtil::TetrominoState::LANDED) {
-#ifndef NDEBUG
-        std::cerr << "error: Trying to remove block(s) from tetromino that has not landed yet\n";
-#endif
-        return; // End function if the tetromino has not landed yet
-    }
-
-    for (auto& block_to_remove : blocks_to_remove) {
-        remove_block(block_to_remove);
-    }
-}
-
 void Tetromino::land_tetromino() {
     tetromino_state = TetrominoUtil::TetrominoState::LANDED;
 
-    bound_game->add_landed(*this);
+    bound_simulation->add_landed(*this);
 }
 
 bool Tetromino::is_block_part(const glm::ivec2 &block) const {
     return blocks.find(block) != blocks.end();
 }
 
-bool Tetromino::tetromino_overlaps(const Tetromino &t) const {
-    for (auto iter = t.blocks.cbegin(); iter != t.blocks.cend(); ++iter) {
-        if (is_block_part(*iter)) {
-            return true;
-        }
-    }
-    return false;
-}
-
 int Tetromino::highest_block() const {
     if (blocks.empty()) {
         throw std::runtime_error("error: highest_block() called on tetromino with no blocks");
@@ -412,6 +385,15 @@ int Tetromino::highest_block() const {
     return highest_block;
 }
 
+uint32_t Tetromino::color_of(TetrominoUtil::TetrominoType type) {
+    return possible_colors[static_cast<int>(type)];
+}
+
+const std::array<ivec2, TetrominoUtil::BLOCKS_IN_TETROMINO>&
+        Tetromino::relative_blocks(TetrominoUtil::TetrominoType type, int rotation_state) {
+    return tetromino_rotations.find(type)->second[rotation_state];
+}
+
 const bool TetrominoUtil::CompareIvec2::operator()(const glm::ivec2 &a, const glm::ivec2 &b) const {
     return a.x < b.x || (a.x == b.x && a.y < b.y);
 }
\ No newline at end of file
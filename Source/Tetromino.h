@@ -18,6 +18,9 @@
 namespace TetrominoUtil {
     static constexpr int BLOCKS_IN_TETROMINO = 4;
     static constexpr size_t NUM_POSSIBLE_COLOURS = 7;
+    static constexpr uint8_t NUM_TYPES = 7;
+    static constexpr uint8_t NUM_ROTATION_STATES = 4;
+    static_assert(NUM_TYPES == NUM_POSSIBLE_COLOURS, "Every type needs a colour");
 
     enum class TetrominoType {
         LINE = 0,
@@ -38,14 +41,22 @@ namespace TetrominoUtil {
         const bool operator()(const glm::ivec2 &a, const glm::ivec2 &b) const;
     };
 
-
+    // Everything needed to recreate a tetromino, in a form which can be copied byte for byte
+    struct Pose {
+        uint8_t type;
+        uint8_t rotation_state;
+        uint8_t state;
+        int8_t  top_left[2];
+        int8_t  blocks[BLOCKS_IN_TETROMINO][2];
+    };
 }
 
-class Game;
+class Simulation;
 
 class Tetromino {
 public:
-    Tetromino(TetrominoUtil::TetrominoType type, Game* game);
+    Tetromino(TetrominoUtil::TetrominoType type, Simulation* simulation);
+    Tetromino(const TetrominoUtil::Pose& pose, Simulation* simulation);
     Tetromino& operator=(const Tetromino& rhs) = default;
 
     // Translation functions
@@ -53,19 +64,13 @@ public:
     bool translate_left();
     bool translate_right();
     bool translate_down(bool is_ghost);
-    void translate_blocks_down(const std::vector<glm::ivec2>& block, int y_translation_factor);
     void jump_down(bool should_land); // Go as low as possible. Used when space key is pressed
 
     // Rotation functions
     void rotate_left();
     void rotate_right();
 
-    bool block_exists(const glm::ivec2& block);
-    void remove_block(const glm::ivec2& block);
-    void remove_blocks(const std::vector<glm::ivec2>& blocks_to_remove);
-
     bool is_block_part(const glm::ivec2 &block) const; // Check if block is a part of this tetromino
-    bool tetromino_overlaps(const Tetromino& t) const; // Check if other tetromino overlaps this tetromino
 
     int highest_block() const; // Returns y coord of highest block in tetromino
 
@@ -75,11 +80,18 @@ public:
     TetrominoUtil::TetrominoState get_state() const { return tetromino_state; }
     TetrominoUtil::TetrominoType get_type() const { return tetromino_type; }
     const glm::ivec2& get_top_left_point() const { return top_left_point; }
+    int get_rotation_state() const { return rotation_state; }
     size_t num_blocks() const { return blocks.size(); };
+    TetrominoUtil::Pose get_pose() const;
+
+    // Lookups into the precomputed tables
+    static uint32_t color_of(TetrominoUtil::TetrominoType type);
+    static const std::array<glm::ivec2, TetrominoUtil::BLOCKS_IN_TETROMINO>&
+            relative_blocks(TetrominoUtil::TetrominoType type, int rotation_state);
 private:
     int rotation_state;
 
-    Game* bound_game; // The game which the Tetromino is a part of
+    Simulation* bound_simulation; // The simulation which the Tetromino is a part of
 
     void land_tetromino();
 
@@ -0,0 +1,108 @@
+#include "UdpSocket.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+
+UdpSocket::UdpSocket(uint16_t local_port, const std::string& remote_host, uint16_t remote_port) {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(remote_host.c_str(), nullptr, &hints, &result) != 0 || result == nullptr) {
+        throw std::runtime_error(std::string("fatal error: Failed to resolve versus peer\nHost: ") + remote_host);
+    }
+    std::memcpy(&remote, result->ai_addr, sizeof(remote));
+    remote.sin_port = htons(remote_port);
+    freeaddrinfo(result);
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd == -1) {
+        throw std::runtime_error("fatal error: Failed to create UDP socket");
+    }
+
+    sockaddr_in local;
+    std::memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(local_port);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) == -1) {
+        close(fd);
+        throw std::runtime_error("fatal error: Failed to bind UDP socket\nPort: " + std::to_string(local_port));
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+UdpSocket::~UdpSocket() {
+    close(fd);
+}
+
+void UdpSocket::set_conditions(double latency_seconds, double loss_fraction) {
+    latency = latency_seconds;
+    loss = loss_fraction;
+}
+
+void UdpSocket::send(const void* data, size_t size) {
+    if (size > UdpSocketUtil::MAX_PACKET_SIZE) {
+        return;
+    }
+    if (loss > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(loss_generator) < loss) {
+        return;
+    }
+
+    if (latency <= 0.0) {
+        send_now(data, size);
+        return;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    DelayedPacket packet;
+    packet.due = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(latency));
+    packet.bytes.assign(bytes, bytes + size);
+    delayed.push_back(std::move(packet));
+}
+
+bool UdpSocket::receive(std::vector<uint8_t>& packet) {
+    flush_delayed();
+
+    uint8_t buffer[UdpSocketUtil::MAX_PACKET_SIZE];
+    sockaddr_in sender;
+    while (true) {
+        // With MSG_TRUNC the whole length of the datagram comes back, even when it did not fit
+        socklen_t sender_size = sizeof(sender);
+        ssize_t received = recvfrom(fd, buffer, sizeof(buffer), MSG_TRUNC,
+                                    reinterpret_cast<sockaddr*>(&sender), &sender_size);
+        if (received < 0) {
+            return false; // Nothing waiting, or an error which the next poll will run into again
+        }
+        if (static_cast<size_t>(received) > sizeof(buffer)) {
+            continue; // Cut short, so it can not be trusted
+        }
+
+        // Ignore anyone but the peer
+        if (sender.sin_addr.s_addr == remote.sin_addr.s_addr && sender.sin_port == remote.sin_port) {
+            packet.assign(buffer, buffer + received);
+            return true;
+        }
+    }
+}
+
+void UdpSocket::send_now(const void* data, size_t size) {
+    // A full send buffer is the same as a lost packet, which the protocol already copes with
+    sendto(fd, data, size, 0, reinterpret_cast<const sockaddr*>(&remote), sizeof(remote));
+}
+
+void UdpSocket::flush_delayed() {
+    Clock::time_point now = Clock::now();
+    while (!delayed.empty() && delayed.front().due <= now) {
+        send_now(delayed.front().bytes.data(), delayed.front().bytes.size());
+        delayed.pop_front();
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef INC_3D_TETRIS_UDPSOCKET_H
+#define INC_3D_TETRIS_UDPSOCKET_H
+
+#include "Util/NonCopyable.h"
+
+#include <netinet/in.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace UdpSocketUtil {
+    // Largest payload which fits in one Ethernet frame without fragmenting
+    // Bigger packets are not sent, and received ones which were cut short are dropped
+    static constexpr size_t MAX_PACKET_SIZE = 1472;
+}
+
+// Non-blocking UDP socket talking to a single peer
+// Outgoing packets can be delayed and dropped on purpose, to try out bad connections over loopback
+class UdpSocket : public Util::NonCopyable {
+public:
+    UdpSocket(uint16_t local_port, const std::string& remote_host, uint16_t remote_port);
+    ~UdpSocket();
+
+    void set_conditions(double latency_seconds, double loss_fraction);
+
+    void send(const void* data, size_t size);
+
+    // Returns false once there is nothing left to read
+    // Also sends any delayed packets which are due
+    bool receive(std::vector<uint8_t>& packet);
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct DelayedPacket {
+        Clock::time_point due;
+        std::vector<uint8_t> bytes;
+    };
+
+    void send_now(const void* data, size_t size);
+    void flush_delayed();
+
+    int fd;
+    sockaddr_in remote;
+
+    double latency = 0.0;
+    double loss = 0.0;
+    std::minstd_rand loss_generator;
+    std::deque<DelayedPacket> delayed; // In order of due time, since the latency is fixed
+};
+
+
+#endif //INC_3D_TETRIS_UDPSOCKET_H
@@ -0,0 +1,99 @@
+#include "GLState.h"
+
+namespace {
+    int capability_index(GLenum capability) {
+        switch (capability) {
+            case GL_BLEND :
+                return 0;
+            case GL_DEPTH_TEST :
+                return 1;
+            case GL_CULL_FACE :
+                return 2;
+            default:
+                return -1;
+        }
+    }
+}
+
+namespace Util {
+    void GLState::use_program(GLuint new_program) {
+        if (changes(program != new_program)) {
+            program = new_program;
+            glUseProgram(program);
+        }
+    }
+
+    void GLState::bind_vertex_array(GLuint new_vertex_array) {
+        if (changes(vertex_array != new_vertex_array)) {
+            vertex_array = new_vertex_array;
+            glBindVertexArray(vertex_array);
+        }
+    }
+
+    void GLState::bind_buffer(GLenum target, GLuint buffer) {
+        GLuint* bound = target == GL_ARRAY_BUFFER ? &array_buffer :
+                        target == GL_UNIFORM_BUFFER ? &uniform_buffer : nullptr;
+        if (bound == nullptr) {
+            ++counters.issued;
+            glBindBuffer(target, buffer);
+        } else if (changes(*bound != buffer)) {
+            *bound = buffer;
+            glBindBuffer(target, buffer);
+        }
+    }
+
+    void GLState::active_texture(GLenum unit) {
+        if (changes(active_unit != unit)) {
+            active_unit = unit;
+            glActiveTexture(unit);
+        }
+    }
+
+    void GLState::bind_texture(GLenum target, GLuint texture) {
+        uint32_t unit = active_unit - GL_TEXTURE0;
+        if (target != GL_TEXTURE_2D || active_unit == UNKNOWN || unit >= MAX_TEXTURE_UNITS) {
+            ++counters.issued;
+            glBindTexture(target, texture);
+        } else if (changes(textures[unit] != texture)) {
+            textures[unit] = texture;
+            glBindTexture(target, texture);
+        }
+    }
+
+    void GLState::set_enabled(GLenum capability, bool enabled) {
+        int index = capability_index(capability);
+        if (index == -1) {
+            ++counters.issued;
+        } else if (changes(capabilities[index] != static_cast<int8_t>(enabled))) {
+            capabilities[index] = static_cast<int8_t>(enabled);
+        } else {
+            return;
+        }
+
+        if (enabled) {
+            glEnable(capability);
+        } else {
+            glDisable(capability);
+        }
+    }
+
+    void GLState::blend_func(GLenum source_factor, GLenum destination_factor) {
+        if (changes(blend_source != source_factor || blend_destination != destination_factor)) {
+            blend_source = source_factor;
+            blend_destination = destination_factor;
+            glBlendFunc(source_factor, destination_factor);
+        }
+    }
+
+    void GLState::invalidate() {
+        program = vertex_array = array_buffer = uniform_buffer = UNKNOWN;
+        active_unit = UNKNOWN;
+        for (GLuint& texture : textures) {
+            texture = UNKNOWN;
+        }
+        for (int8_t& capability : capabilities) {
+            capability = -1;
+        }
+        blend_source = blend_destination = UNKNOWN;
+    }
+}
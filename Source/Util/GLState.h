@@ -0,0 +1,72 @@
+// Shadow of the GL state the renderer changes while drawing
+// Calls which would leave GL as it already is are skipped, and counted, so the saving can be measured.
+// Anything changed without going through here has to be followed by invalidate().
+
+#ifndef INC_3D_TETRIS_GLSTATE_H
+#define INC_3D_TETRIS_GLSTATE_H
+
+#include "NonCopyable.h"
+
+#include <glad/glad.h>
+#include <cstdint>
+
+namespace Util {
+    class GLState : public NonCopyable {
+    public:
+        struct Counters {
+            uint32_t issued;  // State changes passed on to GL
+            uint32_t skipped; // State changes which would not have changed anything
+        };
+
+        GLState() { invalidate(); }
+
+        void use_program(GLuint program);
+        void bind_vertex_array(GLuint vertex_array);
+
+        // Array and uniform buffer bindings are tracked, other targets always go through
+        // The element array binding belongs to the vertex array, so it is never tracked
+        void bind_buffer(GLenum target, GLuint buffer);
+
+        // 2D textures are tracked on the first few units
+        void active_texture(GLenum unit);
+        void bind_texture(GLenum target, GLuint texture);
+
+        // Blending, depth testing and face culling are tracked
+        void set_enabled(GLenum capability, bool enabled);
+        void blend_func(GLenum source_factor, GLenum destination_factor);
+
+        // Forgets everything, so the next call of each kind always goes through
+        void invalidate();
+
+        void reset_counters() { counters = {0, 0}; }
+        const Counters& get_counters() const { return counters; }
+    private:
+        static constexpr GLuint UNKNOWN = 0xFFFFFFFFu; // Never a real name or enum
+        static constexpr uint32_t MAX_TEXTURE_UNITS = 4;
+        static constexpr uint32_t NUM_CAPABILITIES = 3;
+
+        // True when the call is needed, counting it either way
+        bool changes(bool different) {
+            if (different) {
+                ++counters.issued;
+            } else {
+                ++counters.skipped;
+            }
+            return different;
+        }
+
+        GLuint program;
+        GLuint vertex_array;
+        GLuint array_buffer;
+        GLuint uniform_buffer;
+        GLenum active_unit;
+        GLuint textures[MAX_TEXTURE_UNITS];
+        int8_t capabilities[NUM_CAPABILITIES]; // 1 enabled, 0 disabled, -1 unknown
+        GLenum blend_source;
+        GLenum blend_destination;
+
+        Counters counters = {0, 0};
+    };
+}
+
+#endif //INC_3D_TETRIS_GLSTATE_H
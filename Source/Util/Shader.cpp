@@ -5,7 +5,7 @@
 #include <iostream>
 #include <cassert>
 
-Shader::Shader(Shader&& other) : m_ID(other.m_ID) {
+Shader::Shader(Shader&& other) : m_ID(other.m_ID), m_uniform_locations(other.m_uniform_locations) {
     // Increase the references counter
     (*m_references) += 1;
     other.m_references = m_references;
@@ -13,6 +13,7 @@ Shader::Shader(Shader&& other) : m_ID(other.m_ID) {
 
 Shader& Shader::operator=(Shader&& rhs) {
     m_ID = rhs.m_ID;
+    m_uniform_locations = rhs.m_uniform_locations;
 
     // Increase the references counter
     (*m_references) += 1;
@@ -32,7 +33,8 @@ Shader::~Shader() {
     (*m_references) -= 1;
 }
 
-Shader::Shader(const char *vertex_path, const char *fragment_path) : m_references(std::make_shared<unsigned int>(0)) {
+Shader::Shader(const char *vertex_path, const char *fragment_path, const std::string &defines)
+        : m_references(std::make_shared<unsigned int>(0)) {
 
     // 1. retrieve the vertex/fragment source code from filePath
     std::string vertex_code;
@@ -63,6 +65,14 @@ Shader::Shader(const char *vertex_path, const char *fragment_path) : m_reference
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
     }
 
+// defines go straight after the #version line, which has to come first
+    if (!defines.empty()) {
+        for (std::string* code : {&vertex_code, &fragment_code}) {
+            size_t version_end = code->find('\n');
+            code->insert(version_end == std::string::npos ? code->size() : version_end + 1, defines);
+        }
+    }
+
     const char *vertex_shader_code = vertex_code.c_str();
     const char *fragment_shader_code = fragment_code.c_str();
 
@@ -106,6 +116,21 @@ Shader::Shader(const char *vertex_path, const char *fragment_path) : m_reference
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << info_log << std::endl;
     }
 
+// cache uniform locations, so they are never looked up by name again
+    GLint num_uniforms = 0;
+    glGetProgramiv(m_ID, GL_ACTIVE_UNIFORMS, &num_uniforms);
+    for (GLint i = 0; i < num_uniforms; ++i) {
+        char name[256];
+        GLsizei length = 0;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(m_ID, static_cast<GLuint>(i), sizeof(name), &length, &size, &type, name);
+        GLint location = glGetUniformLocation(m_ID, name);
+        if (location != -1) { // uniforms inside a block have none
+            m_uniform_locations[std::string(name, length)] = location;
+        }
+    }
+
 // delete the shaders as they're linked into our program now and no longer necessery
     glDeleteShader(vertex);
     glDeleteShader(fragment);
@@ -117,21 +142,43 @@ void Shader::use() {
 }
 
 void Shader::set_bool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(m_ID, name.c_str()), static_cast<int>(value));
+    glUniform1i(location(name), static_cast<int>(value));
     assert(glGetError() == GL_NO_ERROR);
 }
 
 void Shader::set_int(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(m_ID, name.c_str()), value);
+    glUniform1i(location(name), value);
     assert(glGetError() == GL_NO_ERROR);
 }
 
 void Shader::set_unsigned_int(const std::string &name, unsigned int value) const {
-    glUniform1ui(glGetUniformLocation(m_ID, name.c_str()), value);
+    glUniform1ui(location(name), value);
     assert(glGetError() == GL_NO_ERROR);
 }
 
 void Shader::set_float(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(m_ID, name.c_str()), value);
+    glUniform1f(location(name), value);
     assert(glGetError() == GL_NO_ERROR);
 }
+
+void Shader::set_vec4(const std::string &name, const glm::vec4 &value) const {
+    glUniform4fv(location(name), 1, &value[0]);
+    assert(glGetError() == GL_NO_ERROR);
+}
+
+void Shader::set_mat4(const std::string &name, const glm::mat4 &value) const {
+    glUniformMatrix4fv(location(name), 1, GL_FALSE, &value[0][0]);
+    assert(glGetError() == GL_NO_ERROR);
+}
+
+GLint Shader::location(const std::string &name) const {
+    auto found = m_uniform_locations.find(name);
+    return found != m_uniform_locations.end() ? found->second : -1;
+}
+
+void Shader::bind_uniform_block(const std::string &name, GLuint binding) const {
+    GLuint index = glGetUniformBlockIndex(m_ID, name.c_str());
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(m_ID, index, binding);
+    }
+}
@@ -4,12 +4,18 @@
 #include "NonCopyable.h"
 
 #include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 class Shader : public Util::NonCopyable {
 private:
     GLuint m_ID; // The program ID
+
+    // Every active uniform's location, looked up once the program is linked
+    std::unordered_map<std::string, GLint> m_uniform_locations;
 public:
     GLuint ID() { return m_ID; }
 
@@ -27,16 +33,25 @@ public:
     Shader& operator= (Shader&& rhs);
 
     // constructor reads and builds the shader
-    Shader(const char* vertex_path, const char* fragment_path);
+    // defines are lines of "#define NAME value" put at the top of both stages, to build variants of one source
+    Shader(const char* vertex_path, const char* fragment_path, const std::string& defines = "");
 
     // use/activate the shader
     void use();
 
+    // location of a uniform from the cache, or -1 if the program does not use it, which GL ignores
+    GLint location(const std::string &name) const;
+
     // utility uniform functions
     void set_bool(const std::string &name, bool value) const;
     void set_int(const std::string &name, int value) const;
     void set_unsigned_int(const std::string &name, unsigned int value) const;
     void set_float(const std::string &name, float value) const;
+    void set_vec4(const std::string &name, const glm::vec4 &value) const;
+    void set_mat4(const std::string &name, const glm::mat4 &value) const;
+
+    // points a uniform block at a binding point, to be filled from a uniform buffer bound there
+    void bind_uniform_block(const std::string &name, GLuint binding) const;
 
 };
 
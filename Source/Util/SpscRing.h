@@ -0,0 +1,98 @@
+// Fixed capacity single-producer/single-consumer ring buffer
+// Lock-free, and usable from inside a shared memory mapping as long as
+// it is constructed in place by exactly one of the two sides
+
+#ifndef INC_3D_TETRIS_SPSCRING_H
+#define INC_3D_TETRIS_SPSCRING_H
+
+#include "NonCopyable.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace Util {
+    template <typename T, uint32_t Capacity>
+    class SpscRing : public NonCopyable {
+        static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+        static_assert(ATOMIC_INT_LOCK_FREE == 2, "SpscRing requires lock-free 32 bit atomics");
+    public:
+        SpscRing() : head(0), tail(0) { }
+
+        // Producer side
+        // -------------
+
+        // Returns the slot to be written in place, or nullptr if the ring is full
+        // The slot becomes visible to the consumer once end_push() is called
+        T* begin_push() {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) >= Capacity) {
+                return nullptr;
+            }
+            return &slots[h & (Capacity - 1)];
+        }
+        void end_push() {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        bool push(const T& value) {
+            T* slot = begin_push();
+            if (slot == nullptr) {
+                return false;
+            }
+            *slot = value;
+            end_push();
+            return true;
+        }
+
+        // Consumer side
+        // -------------
+
+        // Returns the oldest unread slot to be read in place, or nullptr if the ring is empty
+        const T* front() const {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            if (t == head.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            return &slots[t & (Capacity - 1)];
+        }
+        void pop() {
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        bool pop(T& value) {
+            const T* slot = front();
+            if (slot == nullptr) {
+                return false;
+            }
+            value = *slot;
+            pop();
+            return true;
+        }
+
+        // Returns the newest slot and marks every older one as read
+        // The newest slot stays reserved, so it is returned again until something newer is pushed
+        const T* latest() {
+            uint32_t h = head.load(std::memory_order_acquire);
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            if (t == h) {
+                return nullptr;
+            }
+            // Only the newest slot is still reserved, so the producer may reuse the rest
+            tail.store(h - 1, std::memory_order_release);
+            return &slots[(h - 1) & (Capacity - 1)];
+        }
+
+        bool empty() const {
+            return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+        }
+        uint32_t size() const {
+            return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+        }
+        static constexpr uint32_t capacity() { return Capacity; }
+    private:
+        // Kept on separate cache lines so the producer and consumer do not contend
+        alignas(64) std::atomic<uint32_t> head; // Next slot to be written
+        alignas(64) std::atomic<uint32_t> tail; // Next slot to be read
+        alignas(64) T slots[Capacity];
+    };
+}
+
+#endif //INC_3D_TETRIS_SPSCRING_H
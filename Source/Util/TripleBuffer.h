@@ -0,0 +1,55 @@
+// Lock-free triple buffer for handing the latest value from one thread to another
+// The writer fills back() and publishes it, the reader picks up whatever was published last.
+// Neither side ever waits, and values the reader never got to are simply skipped.
+
+#ifndef INC_3D_TETRIS_TRIPLEBUFFER_H
+#define INC_3D_TETRIS_TRIPLEBUFFER_H
+
+#include "NonCopyable.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace Util {
+    template <typename T>
+    class TripleBuffer : public NonCopyable {
+        static_assert(ATOMIC_CHAR_LOCK_FREE == 2, "TripleBuffer requires lock-free 8 bit atomics");
+    public:
+        // Writer side
+        // -----------
+
+        // The slot to fill in, never seen by the reader until published
+        T& back() { return slots[back_index]; }
+
+        // Swaps the filled slot with the one in the middle, marking it fresh for the reader
+        void publish() {
+            uint8_t previous = middle.exchange(static_cast<uint8_t>(back_index | FRESH), std::memory_order_acq_rel);
+            back_index = previous & INDEX_MASK;
+        }
+
+        // Reader side
+        // -----------
+
+        // The most recently published value
+        // Stays valid and unchanged until the next call
+        const T& latest() {
+            if (middle.load(std::memory_order_relaxed) & FRESH) {
+                uint8_t previous = middle.exchange(front_index, std::memory_order_acq_rel);
+                front_index = previous & INDEX_MASK;
+            }
+            return slots[front_index];
+        }
+    private:
+        static constexpr uint8_t INDEX_MASK = 0x3;
+        static constexpr uint8_t FRESH = 0x4; // Set while the middle slot has not been picked up
+
+        T slots[3];
+
+        // Each side owns one slot at a time, and the middle one is traded through the atomic
+        alignas(64) uint8_t back_index = 0;
+        alignas(64) uint8_t front_index = 1;
+        alignas(64) std::atomic<uint8_t> middle{2};
+    };
+}
+
+#endif //INC_3D_TETRIS_TRIPLEBUFFER_H
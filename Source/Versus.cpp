@@ -0,0 +1,284 @@
+#include "Versus.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#ifndef NDEBUG
+#include <iostream>
+#endif
+
+namespace {
+    const VersusUtil::TickInputs NO_INPUTS = {0, {}};
+    const uint32_t NO_ROLLBACK = 0xFFFFFFFF;
+}
+
+VersusSession::VersusSession(unsigned int local_player, uint16_t local_port,
+                             const std::string& remote_host, uint16_t remote_port)
+        : local_player(local_player != 0 ? 1 : 0),
+          remote_player(local_player != 0 ? 0 : 1),
+          socket(local_port, remote_host, remote_port),
+          rollback_from(NO_ROLLBACK)
+{
+    std::memset(inputs, 0, sizeof(inputs));
+    std::memset(remote_received, 0, sizeof(remote_received));
+
+    if (this->local_player == 0) {
+        seed = std::random_device()();
+    }
+}
+
+void VersusSession::set_conditions(double latency_seconds, double loss_fraction) {
+    socket.set_conditions(latency_seconds, loss_fraction);
+}
+
+void VersusSession::queue_local_input(SimulationUtil::Input input) {
+    if (pending_local.size() < VersusUtil::MAX_TICK_INPUTS) {
+        pending_local.push_back(input);
+    }
+}
+
+void VersusSession::tick() {
+    poll_network();
+
+    if (!connected) {
+        send_hello();
+        return;
+    }
+    // Until the peer's inputs show up, it may not have heard from us yet
+    if (remote_confirmed == 0) {
+        send_hello();
+    }
+
+    roll_back();
+
+    if (!finished) {
+        check_finished();
+    }
+    if (finished) {
+        pending_local.clear();
+        send_inputs();
+        return;
+    }
+
+    // Wait for the peer instead of running further ahead than can be rolled back
+    if (current_tick > remote_confirmed && current_tick - remote_confirmed >= VersusUtil::MAX_ROLLBACK_TICKS) {
+        ++num_stalls;
+        send_inputs();
+        return;
+    }
+
+    VersusUtil::TickInputs& local = inputs[local_player][current_tick & (VersusUtil::INPUT_HISTORY - 1)];
+    local.count = static_cast<uint8_t>(pending_local.size());
+    for (size_t i = 0; i < pending_local.size(); ++i) {
+        local.inputs[i] = static_cast<uint8_t>(pending_local[i]);
+    }
+    pending_local.clear();
+
+    simulate(current_tick);
+    ++current_tick;
+
+    send_inputs();
+}
+
+uint32_t VersusSession::consume_local_events() {
+    return simulations[local_player].consume_events();
+}
+
+bool VersusSession::did_local_win() const {
+    return finished && simulations[remote_player].is_game_over() && !simulations[local_player].is_game_over();
+}
+
+void VersusSession::poll_network() {
+    std::vector<uint8_t> packet;
+    while (socket.receive(packet)) {
+        if (packet.size() < sizeof(VersusUtil::PacketHeader)) {
+            continue;
+        }
+        VersusUtil::PacketHeader header;
+        std::memcpy(&header, packet.data(), sizeof(header));
+        if (header.magic != VersusUtil::MAGIC || header.player != remote_player) {
+            continue;
+        }
+
+        if (header.type == VersusUtil::PACKET_HELLO && !connected) {
+            if (local_player == 1) {
+                seed = header.first_tick; // Player 0 decides the seed
+            }
+            simulations[0].reset(seed);
+            simulations[1].reset(seed);
+            simulations[local_player].consume_events();
+            connected = true;
+#ifndef NDEBUG
+            std::cerr << "Versus: connected, seed " << seed << "\n";
+#endif
+        } else if (header.type == VersusUtil::PACKET_INPUTS && connected) {
+            handle_inputs_packet(packet);
+        }
+    }
+}
+
+void VersusSession::handle_inputs_packet(const std::vector<uint8_t>& packet) {
+    VersusUtil::PacketHeader header;
+    std::memcpy(&header, packet.data(), sizeof(header));
+    remote_acked = std::max(remote_acked, std::min(header.ack, current_tick));
+
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.num_ticks; ++i) {
+        if (offset >= packet.size()) {
+            return;
+        }
+        uint8_t count = packet[offset];
+        if (count > VersusUtil::MAX_TICK_INPUTS || offset + 1 + count > packet.size()) {
+            return;
+        }
+
+        uint32_t tick = header.first_tick + i;
+        uint32_t slot = tick & (VersusUtil::INPUT_HISTORY - 1);
+        // Only keep ticks which fit in the history and have not been seen yet
+        if (tick >= remote_confirmed && tick < remote_confirmed + VersusUtil::INPUT_HISTORY &&
+            remote_received[slot] != tick + 1) {
+            VersusUtil::TickInputs& remote = inputs[remote_player][slot];
+            remote.count = count;
+            std::memcpy(remote.inputs, &packet[offset + 1], count);
+            remote_received[slot] = tick + 1;
+
+            // The tick was simulated assuming no input, so it was wrong
+            if (tick < current_tick && count != 0) {
+                rollback_from = std::min(rollback_from, tick);
+            }
+        }
+        offset += 1 + count;
+    }
+
+    while (remote_received[remote_confirmed & (VersusUtil::INPUT_HISTORY - 1)] == remote_confirmed + 1) {
+        ++remote_confirmed;
+    }
+}
+
+void VersusSession::send_hello() {
+    VersusUtil::PacketHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = VersusUtil::MAGIC;
+    header.type = VersusUtil::PACKET_HELLO;
+    header.player = static_cast<uint8_t>(local_player);
+    header.first_tick = seed;
+    socket.send(&header, sizeof(header));
+}
+
+void VersusSession::send_inputs() {
+    // Everything the peer has not acknowledged, so one packet getting through is enough
+    // The peer waits for us long before it could fall out of the history
+    uint32_t first_tick = std::max(remote_acked, current_tick > VersusUtil::INPUT_HISTORY ?
+                                                 current_tick - VersusUtil::INPUT_HISTORY : 0);
+
+    VersusUtil::PacketHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = VersusUtil::MAGIC;
+    header.type = VersusUtil::PACKET_INPUTS;
+    header.player = static_cast<uint8_t>(local_player);
+    header.first_tick = first_tick;
+    header.ack = remote_confirmed;
+
+    // Oldest ticks first, stopping before the packet gets too big to arrive whole
+    // The ticks left out go in later packets, once the peer has acknowledged these
+    uint8_t packet[UdpSocketUtil::MAX_PACKET_SIZE];
+    size_t size = sizeof(header);
+    uint32_t tick = first_tick;
+    for (; tick < current_tick; ++tick) {
+        const VersusUtil::TickInputs& local = inputs[local_player][tick & (VersusUtil::INPUT_HISTORY - 1)];
+        if (size + 1 + local.count > sizeof(packet)) {
+            break;
+        }
+        packet[size++] = local.count;
+        std::memcpy(&packet[size], local.inputs, local.count);
+        size += local.count;
+    }
+    header.num_ticks = static_cast<uint16_t>(tick - first_tick);
+    std::memcpy(packet, &header, sizeof(header));
+    socket.send(packet, size);
+}
+
+void VersusSession::check_finished() {
+    // A game over only counts once every tick leading up to it is confirmed, since a late input
+    // could still undo it. Both peers look for the first confirmed tick with a game over,
+    // so they end up on exactly the same state.
+    uint32_t confirmed = std::min(remote_confirmed, current_tick);
+    for (; checked_tick <= confirmed; ++checked_tick) {
+        bool game_over;
+        if (checked_tick == current_tick) {
+            game_over = simulations[0].is_game_over() || simulations[1].is_game_over();
+        } else {
+            const Snapshot& snapshot = snapshots[checked_tick % VersusUtil::SNAPSHOT_SLOTS];
+            game_over = snapshot.states[0].game_over || snapshot.states[1].game_over;
+        }
+        if (!game_over) {
+            continue;
+        }
+
+        // Go back to the moment the game ended, dropping anything simulated after it
+        if (checked_tick < current_tick) {
+            const Snapshot& snapshot = snapshots[checked_tick % VersusUtil::SNAPSHOT_SLOTS];
+            simulations[0].load_state(snapshot.states[0]);
+            simulations[1].load_state(snapshot.states[1]);
+        }
+        finished = true;
+        return;
+    }
+}
+
+void VersusSession::roll_back() {
+    if (rollback_from == NO_ROLLBACK) {
+        return;
+    }
+    uint32_t from = rollback_from;
+    rollback_from = NO_ROLLBACK;
+    if (from >= current_tick) {
+        return;
+    }
+
+    const Snapshot& snapshot = snapshots[from % VersusUtil::SNAPSHOT_SLOTS];
+    simulations[0].load_state(snapshot.states[0]);
+    simulations[1].load_state(snapshot.states[1]);
+
+    for (uint32_t tick = from; tick < current_tick; ++tick) {
+        simulate(tick);
+    }
+    // Sounds for the ticks played again were already heard the first time round
+    simulations[local_player].consume_events();
+
+    ++num_rollbacks;
+    max_rollback_depth = std::max(max_rollback_depth, current_tick - from);
+}
+
+void VersusSession::simulate(uint32_t tick) {
+    Snapshot& snapshot = snapshots[tick % VersusUtil::SNAPSHOT_SLOTS];
+    snapshot.states[0] = simulations[0].save_state();
+    snapshot.states[1] = simulations[1].save_state();
+
+    unsigned int lines_before[2];
+    for (unsigned int player = 0; player < 2; ++player) {
+        lines_before[player] = simulations[player].get_lines_cleared();
+
+        const VersusUtil::TickInputs& tick_inputs = inputs_for(player, tick);
+        SimulationUtil::Input player_inputs[VersusUtil::MAX_TICK_INPUTS];
+        for (uint8_t i = 0; i < tick_inputs.count; ++i) {
+            player_inputs[i] = static_cast<SimulationUtil::Input>(tick_inputs.inputs[i]);
+        }
+        simulations[player].tick(player_inputs, tick_inputs.count);
+    }
+
+    // Garbage is handed over after both players have moved, so the order they tick in does not matter
+    for (unsigned int player = 0; player < 2; ++player) {
+        unsigned int rows = simulations[player].get_lines_cleared() - lines_before[player];
+        simulations[1 - player].add_garbage(VersusUtil::GARBAGE_FOR_ROWS[std::min(rows, 4u)]);
+    }
+}
+
+const VersusUtil::TickInputs& VersusSession::inputs_for(unsigned int player, uint32_t tick) const {
+    uint32_t slot = tick & (VersusUtil::INPUT_HISTORY - 1);
+    if (player == remote_player && remote_received[slot] != tick + 1) {
+        return NO_INPUTS; // Predicted
+    }
+    return inputs[player][slot];
+}
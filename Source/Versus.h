@@ -0,0 +1,124 @@
+#ifndef INC_3D_TETRIS_VERSUS_H
+#define INC_3D_TETRIS_VERSUS_H
+
+#include "Simulation.h"
+#include "UdpSocket.h"
+#include "Util/NonCopyable.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Versus over UDP with rollback
+ * -----------------------------
+ * Both peers simulate both players. Local inputs are applied straight away, remote inputs
+ * are predicted to be empty until they arrive. The state before every tick is kept, so when a
+ * remote input turns up for a tick which was already simulated, the game goes back to that tick
+ * and simulates forward again, all within the same frame.
+ *
+ * Every input packet repeats every tick the peer has not acknowledged yet, so lost packets are
+ * covered by the next one. If the remote side falls too far behind, the local side waits for it.
+ */
+namespace VersusUtil {
+    static constexpr uint32_t MAGIC = 0x54334456; // "T3DV"
+
+    static constexpr uint32_t SNAPSHOT_SLOTS = 64;
+    static constexpr uint32_t MAX_ROLLBACK_TICKS = SNAPSHOT_SLOTS - 4; // Wait for the peer past this
+    static constexpr uint32_t INPUT_HISTORY = 128; // Ticks of inputs kept, a power of two
+    static constexpr uint32_t MAX_TICK_INPUTS = 16; // Inputs past this in one tick are dropped
+
+    enum PacketType : uint8_t {
+        PACKET_HELLO  = 1,
+        PACKET_INPUTS = 2,
+    };
+
+    struct PacketHeader {
+        uint32_t magic;
+        uint8_t  type;
+        uint8_t  player;
+        uint16_t num_ticks; // PACKET_INPUTS only
+        uint32_t first_tick; // PACKET_HELLO: seed of the game. PACKET_INPUTS: tick of the first inputs
+        uint32_t ack;       // PACKET_INPUTS: every input before this tick has been received
+    };
+    // Followed by num_ticks of (count, inputs...)
+
+    struct TickInputs {
+        uint8_t count;
+        uint8_t inputs[MAX_TICK_INPUTS];
+    };
+
+    // Rows of garbage sent to the opponent for each number of rows cleared at once
+    static constexpr unsigned int GARBAGE_FOR_ROWS[5] = {0, 0, 1, 2, 4};
+}
+
+class VersusSession : public Util::NonCopyable {
+public:
+    // Player 0 picks the seed, so one side has to be player 0 and the other player 1
+    VersusSession(unsigned int local_player, uint16_t local_port, const std::string& remote_host, uint16_t remote_port);
+
+    // Artificial latency and loss on outgoing packets
+    void set_conditions(double latency_seconds, double loss_fraction);
+
+    void queue_local_input(SimulationUtil::Input input);
+
+    // Reads the network, rolls back if a late input arrived, then simulates the next tick
+    // Keeps talking to the peer after the game has finished, so it can finish too
+    void tick();
+
+    uint32_t consume_local_events(); // SimulationUtil::Event flags for the local player
+
+    // Getters
+    bool is_connected() const { return connected; }
+    bool is_finished() const { return finished; }
+    bool did_local_win() const;
+    const Simulation& get_local_simulation() const { return simulations[local_player]; }
+    const Simulation& get_remote_simulation() const { return simulations[remote_player]; }
+    uint32_t get_current_tick() const { return current_tick; }
+    uint32_t get_ticks_ahead() const { return current_tick > remote_confirmed ? current_tick - remote_confirmed : 0; }
+    uint32_t get_num_rollbacks() const { return num_rollbacks; }
+    uint32_t get_max_rollback_depth() const { return max_rollback_depth; }
+    uint32_t get_num_stalls() const { return num_stalls; }
+private:
+    void poll_network();
+    void handle_inputs_packet(const std::vector<uint8_t>& packet);
+    void send_hello();
+    void send_inputs();
+
+    void check_finished();
+    void roll_back();
+    void simulate(uint32_t tick); // Saves the state before the tick, then simulates both players
+    const VersusUtil::TickInputs& inputs_for(unsigned int player, uint32_t tick) const;
+
+    struct Snapshot {
+        SimulationUtil::State states[2];
+    };
+
+    unsigned int local_player;
+    unsigned int remote_player;
+    UdpSocket socket;
+
+    Simulation simulations[2];
+    Snapshot snapshots[VersusUtil::SNAPSHOT_SLOTS]; // State before the tick, by tick
+
+    VersusUtil::TickInputs inputs[2][VersusUtil::INPUT_HISTORY];
+    uint32_t remote_received[VersusUtil::INPUT_HISTORY]; // Tick + 1 of the remote inputs in each slot
+    std::vector<SimulationUtil::Input> pending_local; // Inputs for the next tick
+
+    uint32_t seed = 0;
+    bool connected = false;
+    bool finished = false;
+
+    uint32_t current_tick = 0;     // Next tick to simulate
+    uint32_t remote_confirmed = 0; // Remote inputs are known for every tick before this
+    uint32_t remote_acked = 0;     // The peer has every local input before this
+    uint32_t rollback_from;        // Earliest tick simulated with a wrong prediction
+    uint32_t checked_tick = 0;     // Next confirmed tick to check for a game over
+
+    uint32_t num_rollbacks = 0;
+    uint32_t max_rollback_depth = 0;
+    uint32_t num_stalls = 0;
+};
+
+
+#endif //INC_3D_TETRIS_VERSUS_H
@@ -12,10 +12,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include <array>
+#include <algorithm>
 #include <cassert>
-#include <memory>
 #include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <memory>
 
 #ifndef NDEBUG
 #include <iostream>
@@ -27,6 +29,59 @@ inline void init_glad();
 static void glfw_error(int id, const char* description);
 #endif
 
+// A unit cube, moved into place by each block instance
+static const float CUBE_VERTICES[] = {
+    // Vertex coords |Tex coords
+    // x  y  z       |
+       0, 0, 0,       0, 1, // Front top-left
+       1, 0, 0,       1, 1, // Front top-right
+       0, 1, 0,       0, 0, // Front bottom-left
+       1, 1, 0,       1, 0, // Front bottom-right
+
+       1, 0, 1,       0, 1, // Back top-left
+       0, 0, 1,       1, 1, // Back top-right
+       1, 1, 1,       0, 0, // Back bottom-left
+       0, 1, 1,       1, 0, // Back bottom-right
+
+                            // Separate vertices for top & bottom
+                            // Due to texture coords
+       0, 0, 0,       0, 0, // Front top-left (drawn for top face)
+       0, 0, 1,       0, 1, // Back top-right (drawn for top face)
+       1, 0, 1,       1, 1, // Back top-left  (drawn for top face)
+       1, 0, 0,       1, 0, // Front top-right (drawn for top face)
+
+       1, 1, 0,       1, 1, // Front bottom-right (drawn for bottom face)
+       0, 1, 0,       0, 1, // Front bottom-left (drawn for bottom face)
+       0, 1, 1,       0, 0, // Back bottom-right  (drawn for bottom face)
+       1, 1, 1,       1, 0, // Back bottom-left (drawn for bottom face)
+};
+
+static const unsigned int CUBE_INDICES[] = {
+    // Front face
+    0, 1, 3,
+    3, 2, 0,
+
+    // Right-side face
+    1, 4, 6,
+    6, 3, 1,
+
+    // Back face
+    4, 5, 7,
+    7, 6, 4,
+
+    // Left-side face
+    5, 0, 2,
+    2, 7, 5,
+
+    // Top face
+    8, 9, 10,
+    10, 11, 8,
+
+    // Bottom face
+    13, 12, 15,
+    15, 14, 13,
+};
+
 ViewComponent::ViewComponent(const std::string& vert_shader_src,
                              const std::string& frag_shader_src,
                              const std::string& texture_src,
@@ -53,15 +108,7 @@ ViewComponent::ViewComponent(const std::string& vert_shader_src,
                                    }
     );
 
-    // Enable alpha blending
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
-
-    // Enable face culling
-    glEnable(GL_CULL_FACE);
+    // Face culling
     glCullFace(GL_BACK);
     glFrontFace(GL_CCW);
 
@@ -69,22 +116,35 @@ ViewComponent::ViewComponent(const std::string& vert_shader_src,
     glClearColor(0, 0, 0, 0.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Create shader
-    shader_prog.reset(new Shader(vert_shader_src.c_str(), frag_shader_src.c_str()));
+    // Create a shader program for each pass, built from the same sources
+    const std::string PASS_DEFINES[NUM_PASSES] = {
+            "#define BLOCK_PASS\n",
+            "#define GHOST_PASS\n#define GHOST_ALPHA " + std::to_string(FADING_FACTOR / 100.0f) + "\n",
+            "#define TEXT_PASS\n",
+    };
+    for (int pass = 0; pass < NUM_PASSES; ++pass) {
+        shader_progs[pass].reset(new Shader(vert_shader_src.c_str(), frag_shader_src.c_str(), PASS_DEFINES[pass]));
 
-    // Generate vertex array object
-    glGenVertexArrays(1, &vao);
+        // Send constants to shader
+        shader_progs[pass]->use();
+        shader_progs[pass]->set_int("SCREEN_WIDTH", SCREEN_WIDTH);
+        shader_progs[pass]->set_int("SCREEN_HEIGHT", SCREEN_HEIGHT);
+        shader_progs[pass]->set_int("BLOCK_SIZE", BLOCK_SIZE);
 
-    // Generate vertex buffer object
-    glGenBuffers(1, &vbo);
+        // Send block texture to shader
+        shader_progs[pass]->set_int("block_texture", 0);
+    }
 
-    // Generate element buffer object
-    glGenBuffers(1, &ebo);
+    // Text vertex array, one quad rewritten for every glyph
+    // -----------------------------------------------------
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
 
     // Bind vao to store VertexAttribPointer call
     glBindVertexArray(vao);
 
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, 6 * 5 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
 
     // Setting vertex attributes
     // -------------------------
@@ -99,6 +159,57 @@ ViewComponent::ViewComponent(const std::string& vert_shader_src,
     // Unbind vao (vertex array object)
     glBindVertexArray(0);
 
+    // Block vertex arrays, a static unit cube and a buffer of instances
+    // -----------------------------------------------------------------
+    // Cube vertices and indices are uploaded once
+    glGenBuffers(1, &cube_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, cube_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTICES), CUBE_VERTICES, GL_STATIC_DRAW);
+    glGenBuffers(1, &cube_ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cube_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CUBE_INDICES), CUBE_INDICES, GL_STATIC_DRAW);
+
+    // Queued blocks are rewritten every frame
+    glGenBuffers(1, &instance_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(block_instances), nullptr, GL_STREAM_DRAW);
+    block_vao = create_block_vao(instance_vbo);
+
+    // The border never changes, so it is queued once and kept on the GPU
+    build_border();
+    glGenBuffers(1, &border_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, border_vbo);
+    glBufferData(GL_ARRAY_BUFFER, num_block_instances * sizeof(ViewComponentUtil::BlockInstance), block_instances,
+                 GL_STATIC_DRAW);
+    border_vao = create_block_vao(border_vbo);
+    num_border_instances = num_block_instances;
+    num_block_instances = 0;
+
+    // Landed stack vertex array, a slot of vertices for every row of the board
+    // ------------------------------------------------------------------------
+    using ViewComponentUtil::StackVertex;
+    glGenVertexArrays(1, &stack_vao);
+    glGenBuffers(1, &stack_vbo);
+    glBindVertexArray(stack_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, stack_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(stack_vertices), nullptr, GL_DYNAMIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(StackVertex), (void*)offsetof(StackVertex, x));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(StackVertex), (void*)offsetof(StackVertex, u));
+    glEnableVertexAttribArray(1);
+
+    // Uses the block colour attribute, but per vertex, and leaves the block position at zero
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(StackVertex),
+                          (void*)offsetof(StackVertex, color));
+    glEnableVertexAttribArray(3);
+    glBindVertexArray(0);
+
+    for (unsigned int y = 0; y < GAME_HEIGHT; ++y) {
+        stack_row_first[y] = static_cast<GLint>(y * ViewComponentUtil::MAX_ROW_VERTICES);
+        stack_row_count[y] = 0;
+    }
+
     // Unbind buffers
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
@@ -142,10 +253,62 @@ ViewComponent::ViewComponent(const std::string& vert_shader_src,
                                          0.1f,
                                          100.0f);
 
+    // Camera uniform buffer, holding the view and projection for blocks and then for text
+    // The text camera never changes, and neither does the block projection
+    // ----------------------------------------------------------------------
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = std::max(alignment, 1);
+    text_camera_offset = (ViewComponentUtil::CAMERA_SIZE + alignment - 1) / alignment * alignment;
+
+    static const glm::mat4 text_camera[2] = {
+            glm::mat4(1.0f), // Disable effects of view matrix
+            glm::ortho(0.0f, static_cast<float>(SCREEN_WIDTH), 0.0f, static_cast<float>(SCREEN_HEIGHT))
+    };
+    glGenBuffers(1, &camera_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, camera_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, text_camera_offset + ViewComponentUtil::CAMERA_SIZE, nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(projection_matrix));
+    glBufferSubData(GL_UNIFORM_BUFFER, text_camera_offset, sizeof(text_camera), text_camera);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferRange(GL_UNIFORM_BUFFER, ViewComponentUtil::BLOCK_CAMERA_BINDING, camera_ubo,
+                      0, ViewComponentUtil::CAMERA_SIZE);
+    glBindBufferRange(GL_UNIFORM_BUFFER, ViewComponentUtil::TEXT_CAMERA_BINDING, camera_ubo,
+                      text_camera_offset, ViewComponentUtil::CAMERA_SIZE);
+
+    // Every other uniform is set once here, so switching passes is only a change of program
+    static const glm::vec4 TEXT_COLOR = {255.0f, 255.0f, 255.0f, 255.0f}; // White
+    for (int pass = 0; pass < NUM_PASSES; ++pass) {
+        shader_progs[pass]->use();
+        if (pass == TEXT_PASS) {
+            // Text is drawn flat over the screen, so the model matrix is left out
+            shader_progs[pass]->set_mat4("model", glm::mat4(1.0f));
+            shader_progs[pass]->set_vec4("color", TEXT_COLOR);
+            shader_progs[pass]->bind_uniform_block("Camera", ViewComponentUtil::TEXT_CAMERA_BINDING);
+        } else {
+            shader_progs[pass]->set_mat4("model", model_matrix);
+            shader_progs[pass]->bind_uniform_block("Camera", ViewComponentUtil::BLOCK_CAMERA_BINDING);
+        }
+    }
+
     // Load font component
     // -------------------
 
     font_component = std::make_shared<FontComponent>(font_src);
+
+    // Everything above was bound directly, so from here on the state is tracked
+    // -------------------------------------------------------------------------
+    gl_state.invalidate();
+
+    // Enable alpha blending
+    gl_state.set_enabled(GL_BLEND, true);
+    gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Enable depth testing
+    gl_state.set_enabled(GL_DEPTH_TEST, true);
+
+    // Enable face culling
+    gl_state.set_enabled(GL_CULL_FACE, true);
 }
 
 ViewComponent::~ViewComponent() {
@@ -153,147 +316,306 @@ ViewComponent::~ViewComponent() {
     glfwTerminate();
 }
 
-void ViewComponent::draw_tetromino(const Tetromino &tetromino, bool is_ghost_tetromino) {
+void ViewComponent::draw_tetromino(const Tetromino &tetromino, bool is_ghost_tetromino, glm::vec2 offset) {
     uint32_t color = tetromino.get_color();
     for (const auto& block : tetromino.get_blocks()) {
-        draw_block(block, color, is_ghost_tetromino);
+        draw_block(glm::vec2(block) + offset, color, is_ghost_tetromino);
     }
 }
 
-void ViewComponent::swap_buffers() {
-    glfwSwapBuffers(window);
+void ViewComponent::draw_board(const Board& board) {
+    update_stack_mesh(board);
+
+    // Anything queued goes first, so blending comes out in the order it was drawn in
+    flush_blocks();
+
+    use_pass(BLOCK_PASS);
+
+    // Every row in one draw, empty rows just have nothing in them
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, block_texture);
+    gl_state.bind_vertex_array(stack_vao);
+    glMultiDrawArrays(GL_TRIANGLES, stack_row_first, stack_row_count, GAME_HEIGHT);
+    ++counters.draw_calls;
 }
 
-void ViewComponent::clear_screen() {
-    glClearColor(0, 0, 0, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void ViewComponent::update_stack_mesh(const Board& board) {
+    // Find the rows which changed since the mesh was last built
+    const BoardUtil::Cell* cells = board.data();
+    int first_changed = GAME_HEIGHT;
+    int last_changed = -1;
+    for (int y = 0; y < static_cast<int>(GAME_HEIGHT); ++y) {
+        if (std::memcmp(&cells[y * GAME_WIDTH], &stack_cells[y * GAME_WIDTH],
+                        GAME_WIDTH * sizeof(BoardUtil::Cell)) != 0) {
+            first_changed = std::min(first_changed, y);
+            last_changed = y;
+        }
+    }
+    if (last_changed < 0) {
+        return; // Only the current tetromino moved
+    }
+    std::memcpy(&stack_cells[first_changed * GAME_WIDTH], &cells[first_changed * GAME_WIDTH],
+                (last_changed - first_changed + 1) * GAME_WIDTH * sizeof(BoardUtil::Cell));
+
+    // Which top and bottom faces are hidden depends on the rows either side, so they are rebuilt too
+    first_changed = std::max(first_changed - 1, 0);
+    last_changed = std::min(last_changed + 1, static_cast<int>(GAME_HEIGHT) - 1);
+    for (int y = first_changed; y <= last_changed; ++y) {
+        mesh_stack_row(y);
+    }
+
+    // Upload the rebuilt rows in one go
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, stack_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, first_changed * sizeof(stack_vertices[0]),
+                    (last_changed - first_changed + 1) * sizeof(stack_vertices[0]), stack_vertices[first_changed]);
+    ++counters.buffer_uploads;
 }
 
-std::shared_ptr<std::array<float, 80>> generate_block_vertex_data(const glm::ivec2 &block);
+void ViewComponent::mesh_stack_row(int y) {
+    using ViewComponentUtil::StackVertex;
 
-void ViewComponent::draw_block(const glm::ivec2 &block, uint32_t color, bool is_faded) {
-    auto vertices = generate_block_vertex_data(block);
+    // Cells past the edges of the board are behind the border, so they count as occupied
+    auto empty = [this](int x, int y) {
+        return x >= 0 && x < static_cast<int>(GAME_WIDTH) && y >= 0 && y < static_cast<int>(GAME_HEIGHT) &&
+               stack_cells[y * GAME_WIDTH + x] == BoardUtil::EMPTY_CELL;
+    };
 
-    static unsigned int indices[] = {
-            // Front face
-            0, 1, 3,
-            3, 2, 0,
+    StackVertex* vertices = stack_vertices[y];
+    uint32_t num_vertices = 0;
+
+    // Adds the quad a, b, c, d as the triangles a, b, c and c, d, a, the same as a face of the cube
+    uint8_t color[4];
+    auto add_quad = [&](const glm::vec3 (&corners)[4], const glm::vec2 (&tex_coords)[4]) {
+        static constexpr int ORDER[6] = {0, 1, 2, 2, 3, 0};
+        for (int i : ORDER) {
+            StackVertex& vertex = vertices[num_vertices++];
+            vertex.x = corners[i].x;
+            vertex.y = corners[i].y;
+            vertex.z = corners[i].z;
+            vertex.u = tex_coords[i].x;
+            vertex.v = tex_coords[i].y;
+            std::memcpy(vertex.color, color, sizeof(color));
+        }
+    };
 
-            // Right-side face
-            1, 4, 6,
-            6, 3, 1,
+    // Greedy meshing within the row: runs of cells of the same colour share their faces,
+    // with texture coordinates running past one so the texture repeats once per block
+    float top = static_cast<float>(y);
+    float bottom = static_cast<float>(y + 1);
+    for (int x = 0; x < static_cast<int>(GAME_WIDTH);) {
+        BoardUtil::Cell cell = stack_cells[y * GAME_WIDTH + x];
+        if (cell == BoardUtil::EMPTY_CELL) {
+            ++x;
+            continue;
+        }
+
+        int run_end = x + 1;
+        while (run_end < static_cast<int>(GAME_WIDTH) && stack_cells[y * GAME_WIDTH + run_end] == cell) {
+            ++run_end;
+        }
+
+        uint32_t rgb = Tetromino::color_of(BoardUtil::type_from_cell(cell));
+        color[0] = static_cast<uint8_t>((rgb >> 16) & 0xFFu);
+        color[1] = static_cast<uint8_t>((rgb >> 8) & 0xFFu);
+        color[2] = static_cast<uint8_t>(rgb & 0xFFu);
+        color[3] = 100;
+
+        // Front and back faces always face out of the board
+        float left = static_cast<float>(x);
+        float right = static_cast<float>(run_end);
+        float width = right - left;
+        add_quad({{left, top, 0}, {right, top, 0}, {right, bottom, 0}, {left, bottom, 0}},
+                 {{0, 1}, {width, 1}, {width, 0}, {0, 0}});
+        add_quad({{right, top, 1}, {left, top, 1}, {left, bottom, 1}, {right, bottom, 1}},
+                 {{0, 1}, {width, 1}, {width, 0}, {0, 0}});
+
+        // Top and bottom faces, merged over every stretch of the run with nothing above or below it
+        for (int side = 0; side < 2; ++side) {
+            int neighbour_y = side == 0 ? y - 1 : y + 1;
+            for (int start = x; start < run_end;) {
+                if (!empty(start, neighbour_y)) {
+                    ++start;
+                    continue;
+                }
+                int end = start + 1;
+                while (end < run_end && empty(end, neighbour_y)) {
+                    ++end;
+                }
+
+                float face_left = static_cast<float>(start);
+                float face_right = static_cast<float>(end);
+                float face_width = face_right - face_left;
+                if (side == 0) {
+                    add_quad({{face_left, top, 0}, {face_left, top, 1}, {face_right, top, 1}, {face_right, top, 0}},
+                             {{0, 0}, {0, 1}, {face_width, 1}, {face_width, 0}});
+                } else {
+                    add_quad({{face_left, bottom, 0}, {face_right, bottom, 0}, {face_right, bottom, 1},
+                              {face_left, bottom, 1}},
+                             {{0, 1}, {face_width, 1}, {face_width, 0}, {0, 0}});
+                }
+                start = end;
+            }
+        }
+
+        // Side faces, only at the ends of the run since cells inside it hide each other's
+        if (empty(x - 1, y)) {
+            add_quad({{left, top, 1}, {left, top, 0}, {left, bottom, 0}, {left, bottom, 1}},
+                     {{1, 1}, {0, 1}, {0, 0}, {1, 0}});
+        }
+        if (empty(run_end, y)) {
+            add_quad({{right, top, 0}, {right, top, 1}, {right, bottom, 1}, {right, bottom, 0}},
+                     {{1, 1}, {0, 1}, {0, 0}, {1, 0}});
+        }
+
+        x = run_end;
+    }
 
-            // Back face
-            4, 5, 7,
-            7, 6, 4,
+    stack_row_count[y] = static_cast<GLsizei>(num_vertices);
+}
+
+void ViewComponent::swap_buffers() {
+    flush_blocks();
+    glfwSwapBuffers(window);
+}
 
-            // Left-side face
-            5, 0, 2,
-            2, 7, 5,
+void ViewComponent::set_swap_interval(int interval) {
+    glfwSwapInterval(interval);
+}
 
-            // Top face
-            8, 9, 10,
-            10, 11, 8,
+bool ViewComponent::supports_adaptive_vsync() const {
+    return glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+}
 
-            // Bottom face
-            13, 12, 15,
-            15, 14, 13,
-    };
+void ViewComponent::reset_counters() {
+    counters = {0, 0, 0, 0};
+    gl_state.reset_counters();
+}
 
-    shader_prog->use();
+ViewComponentUtil::RenderCounters ViewComponent::get_counters() const {
+    ViewComponentUtil::RenderCounters result = counters;
+    result.state_changes = gl_state.get_counters().issued;
+    result.redundant_state_changes = gl_state.get_counters().skipped;
+    return result;
+}
 
-    if (draw_mode != GRAPHICS_MODE) {
-        draw_mode = GRAPHICS_MODE;
-        shader_prog->set_bool("in_text_mode", false);
+std::string ViewComponent::get_renderer_name() const {
+    const GLubyte* name = glGetString(GL_RENDERER);
+    return name != nullptr ? reinterpret_cast<const char*>(name) : "unknown";
+}
+
+void ViewComponent::clear_screen() {
+    glClearColor(0, 0, 0, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void ViewComponent::draw_block(const glm::vec2 &block, uint32_t color, bool is_faded) {
+    // Faded blocks have a program of their own, so they can not share a draw with the rest
+    if (num_block_instances == ViewComponentUtil::MAX_BLOCK_INSTANCES ||
+        (num_block_instances != 0 && is_faded != queued_faded)) {
+        flush_blocks();
     }
+    queued_faded = is_faded;
+
+    ViewComponentUtil::BlockInstance& instance = block_instances[num_block_instances++];
+    instance.x = block.x;
+    instance.y = block.y;
+    instance.color[0] = static_cast<uint8_t>((color >> 16) & 0xFFu);
+    instance.color[1] = static_cast<uint8_t>((color >> 8) & 0xFFu);
+    instance.color[2] = static_cast<uint8_t>(color & 0xFFu);
+    instance.color[3] = static_cast<uint8_t>(is_faded ? FADING_FACTOR : 100);
+}
 
-    // If it is the first iteration, glBufferData must be used to generate the buffers
-    // Otherwise, use glBufferSubData to avoid reallocating the buffer every tick
-    if (first_iteration) {
-        // Send constants to shader
-        shader_prog->set_int("SCREEN_WIDTH", SCREEN_WIDTH);
-        shader_prog->set_int("SCREEN_HEIGHT", SCREEN_HEIGHT);
-        shader_prog->set_int("BLOCK_SIZE", BLOCK_SIZE);
+void ViewComponent::flush_blocks() {
+    if (num_block_instances == 0) {
+        return;
+    }
 
-        // Send block texture to shader
-        shader_prog->set_int("block_texture", 0);
+    use_pass(queued_faded ? GHOST_PASS : BLOCK_PASS);
 
+    // Upload the instances
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, instance_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, num_block_instances * sizeof(ViewComponentUtil::BlockInstance),
+                    block_instances);
+    ++counters.buffer_uploads;
 
-        glBindVertexArray(vao);
+    // Draw every block at once, in the order they were queued so blending comes out the same
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, block_texture);
+    gl_state.bind_vertex_array(block_vao);
+    glDrawElementsInstanced(GL_TRIANGLES, sizeof(CUBE_INDICES) / sizeof(unsigned int), GL_UNSIGNED_INT, nullptr,
+                            static_cast<GLsizei>(num_block_instances));
+    ++counters.draw_calls;
 
-        // Buffer data into vbo
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices->size() * sizeof(int), vertices.get(), GL_DYNAMIC_DRAW);
+    num_block_instances = 0;
+}
 
-        // Buffer data into ebo
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+GLuint ViewComponent::create_block_vao(GLuint instances) {
+    using ViewComponentUtil::BlockInstance;
 
-        glBindVertexArray(0);
-    } else {
-        glBindVertexArray(vao);
+    GLuint new_vao;
+    glGenVertexArrays(1, &new_vao);
+    glBindVertexArray(new_vao);
 
-        // Reset vbo
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices->size() * sizeof(int), vertices.get());
+    glBindBuffer(GL_ARRAY_BUFFER, cube_vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cube_ebo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
 
-        // Ebo is not reset since it is unchanging
+    // Instance attributes step once per cube rather than once per vertex
+    glBindBuffer(GL_ARRAY_BUFFER, instances);
 
-        glBindVertexArray(0);
-    }
+    // Set vertex attribute for block position
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(BlockInstance), (void*)offsetof(BlockInstance, x));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
 
-    // Send matrices to shaders
-    // ------------------------
-
-    // Send model matrix
-    int model_loc = glGetUniformLocation(static_cast<GLuint>(shader_prog->ID()), "model");
-    glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(model_matrix));
-
-    // Rotate view matrix
-    static constexpr float radius = DISTANCE_BETWEEN_CAMERA_AND_GAME;
-    float camX = std::sin(view_rot) * radius;
-    float camZ = std::cos(view_rot) * radius;
-    view_matrix  = glm::lookAt(glm::vec3(camX, -0.38f, camZ),
-                               glm::vec3(0.0f, -0.38f, 0.0f),
-                               glm::vec3(0.0f, 1.0f, 0.0f));
-    // Send view matrix
-    int view_loc = glGetUniformLocation(static_cast<GLuint>(shader_prog->ID()), "view");
-    glUniformMatrix4fv(view_loc, 1, GL_FALSE, glm::value_ptr(view_matrix));
-
-    // Send projection matrix
-    int projection_loc = glGetUniformLocation(static_cast<GLuint>(shader_prog->ID()), "projection");
-    glUniformMatrix4fv(projection_loc, 1, GL_FALSE, glm::value_ptr(projection_matrix));
-
-    // Set colour and supply it to shader
-    glm::vec4 color_vec;
-    if (is_faded) {
-        color_vec = {static_cast<int>((color >> 16) & 0xFFu),
-                     static_cast<int>((color >> 8) & 0xFFu),
-                     static_cast<int>(color & 0xFFu),
-                     FADING_FACTOR};
-    } else {
-        color_vec = {static_cast<int>((color >> 16) & 0xFFu),
-                     static_cast<int>((color >> 8) & 0xFFu),
-                     static_cast<int>(color & 0xFFu),
-                     100};
-    }
-    int color_loc = glGetUniformLocation(static_cast<GLuint>(shader_prog->ID()), "color");
-    glUniform4fv(color_loc, 1, glm::value_ptr(color_vec));
+    // Set vertex attribute for block colour, kept out of 255 and 100 like the colour uniform
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(BlockInstance),
+                          (void*)offsetof(BlockInstance, color));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
 
-    // Draw block
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, block_texture);
-    glBindVertexArray(vao);
-    glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(unsigned int), GL_UNSIGNED_INT, nullptr);
     glBindVertexArray(0);
+    return new_vao;
+}
 
-    // Since it is no longer the first iteration
-    if (first_iteration) {
-        first_iteration = false;
+void ViewComponent::use_pass(Pass pass) {
+    gl_state.use_program(shader_progs[pass]->ID());
+
+    // The view only changes when the camera is turned, so it is uploaded at most once a frame
+    if (pass != TEXT_PASS && view_changed) {
+        view_changed = false;
+
+        // Rotate view matrix
+        static constexpr float radius = DISTANCE_BETWEEN_CAMERA_AND_GAME;
+        float camX = std::sin(view_rot) * radius;
+        float camZ = std::cos(view_rot) * radius;
+        view_matrix  = glm::lookAt(glm::vec3(camX, -0.38f, camZ),
+                                   glm::vec3(0.0f, -0.38f, 0.0f),
+                                   glm::vec3(0.0f, 1.0f, 0.0f));
+        gl_state.bind_buffer(GL_UNIFORM_BUFFER, camera_ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(view_matrix));
+        ++counters.buffer_uploads;
     }
 }
 
 void ViewComponent::draw_border() {
+    // Anything queued goes first, so blending comes out in the order it was drawn in
+    flush_blocks();
+
+    use_pass(BLOCK_PASS);
+
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(GL_TEXTURE_2D, block_texture);
+    gl_state.bind_vertex_array(border_vao);
+    glDrawElementsInstanced(GL_TRIANGLES, sizeof(CUBE_INDICES) / sizeof(unsigned int), GL_UNSIGNED_INT, nullptr,
+                            static_cast<GLsizei>(num_border_instances));
+    ++counters.draw_calls;
+}
+
+void ViewComponent::build_border() {
     static constexpr uint32_t BORDER_COLOR = 0xC0C0C0;
 
     // Draw bottom and top
@@ -316,35 +638,14 @@ void ViewComponent::draw_border() {
 }
 
 void ViewComponent::draw_message(glm::ivec2 top_left, float scale, const std::string& msg) {
-    shader_prog->use();
+    // Text goes over the blocks, so they have to be drawn first
+    flush_blocks();
 
-    if (draw_mode != TEXT_MODE) {
-        draw_mode = TEXT_MODE;
-        shader_prog->set_bool("in_text_mode", true);
-    }
-
-    // Change projection matrix to be orthographic
-    static const glm::mat4 orthographic_projection_matrix
-            = glm::ortho(0.0f, static_cast<float>(SCREEN_WIDTH), 0.0f, static_cast<float>(SCREEN_HEIGHT));
-    int projection_loc = glGetUniformLocation(static_cast<GLuint>(shader_prog->ID()), "projection");
-    glUniformMatrix4fv(projection_loc, 1, GL_FALSE, glm::value_ptr(orthographic_projection_matrix));
+    use_pass(TEXT_PASS);
 
-    // Disable effects of view matrix
-    static const glm::mat4 identity_matrix = glm::mat4(1.0f);
-    int view_loc = glGetUniformLocation(static_cast<GLuint>(shader_prog->ID()), "view");
-    glUniformMatrix4fv(view_loc, 1, GL_FALSE, glm::value_ptr(identity_matrix));
-
-    // Disable effects of model matrix
-    int model_loc = glGetUniformLocation(static_cast<GLuint>(shader_prog->ID()), "model");
-    glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(identity_matrix));
-
-    // Send in text color
-    static const glm::vec4 TEXT_COLOR = {255.0f, 255.0f, 255.0f, 255.0f}; // White
-    int color_loc = glGetUniformLocation(static_cast<GLuint>(shader_prog->ID()), "color");
-    glUniform4fv(color_loc, 1, glm::value_ptr(TEXT_COLOR));
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(vao);
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_vertex_array(vao);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, vbo);
 
     // Render text character by character
     for (auto c = msg.cbegin(); c != msg.cend(); ++c) {
@@ -368,71 +669,41 @@ void ViewComponent::draw_message(glm::ivec2 top_left, float scale, const std::st
         };
 
         // Update content of VBO memory
-
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
         glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        ++counters.buffer_uploads;
 
         // Render glyph texture over quad
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, g.texture_id);
+        gl_state.bind_texture(GL_TEXTURE_2D, g.texture_id);
 
         // Render quad
         glDrawArrays(GL_TRIANGLES, 0, 6);
+        ++counters.draw_calls;
 
         // Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         top_left.x += (g.advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-std::shared_ptr<std::array<float, 80>> generate_block_vertex_data(const glm::ivec2 &int_block) {
-    glm::vec2 block = int_block;
-
-    auto vertices = std::make_shared<std::array<float, 80>>(std::array<float, 80>{
-        // Vertex coords        |Tex coords
-        // x       y          z |
-        block.x  , block.y  , 0, 0, 1, // Front top-left
-        block.x+1, block.y  , 0, 1, 1, // Front top-right
-        block.x  , block.y+1, 0, 0, 0, // Front bottom-left
-        block.x+1, block.y+1, 0, 1, 0, // Front bottom-right
-
-        block.x+1, block.y  , 1, 0, 1, // Back top-left
-        block.x  , block.y  , 1, 1, 1, // Back top-right
-        block.x+1, block.y+1, 1, 0, 0, // Back bottom-left
-        block.x  , block.y+1, 1, 1, 0, // Back bottom-right
-
-                                       // Separate vertices for top & bottom
-                                       // Due to texture coords
-        block.x  , block.y  , 0, 0, 0, // Front top-left (drawn for top face)
-        block.x  , block.y  , 1, 0, 1, // Back top-right (drawn for top face)
-        block.x+1, block.y  , 1, 1, 1, // Back top-left  (drawn for top face)
-        block.x+1, block.y  , 0, 1, 0, // Front top-right (drawn for top face)
-
-        block.x+1, block.y+1, 0, 1, 1, // Front bottom-right (drawn for bottom face)
-        block.x  , block.y+1, 0, 0, 1, // Front bottom-left (drawn for bottom face)
-        block.x  , block.y+1, 1, 0, 0, // Back bottom-right  (drawn for bottom face)
-        block.x+1, block.y+1, 1, 1, 0, // Back bottom-left (drawn for bottom face)
-    });
-
-
-    return vertices;
-};
+void ViewComponent::reset_view_rotation() {
+    if (view_rot != 0.0f) {
+        view_rot = 0.0f;
+        view_changed = true;
+    }
+}
 
-void ViewComponent::rotate_view_left() {
-    view_rot -= ROTATION_INCREMENT;
-    if (view_rot <= -(2 * M_PI) + ROTATION_INCREMENT &&
-        view_rot >= -(2 * M_PI) - ROTATION_INCREMENT) {
-        view_rot = 0;
+void ViewComponent::rotate_view_left(float seconds) {
+    view_changed = true;
+    view_rot -= ROTATION_SPEED * seconds;
+    if (view_rot <= -(2 * M_PI)) {
+        view_rot += 2 * M_PI;
     }
 }
 
-void ViewComponent::rotate_view_right() {
-    view_rot += ROTATION_INCREMENT;
-    if (view_rot <= (2 * M_PI) + ROTATION_INCREMENT &&
-        view_rot >= (2 * M_PI) - ROTATION_INCREMENT) {
-        view_rot = 0;
+void ViewComponent::rotate_view_right(float seconds) {
+    view_changed = true;
+    view_rot += ROTATION_SPEED * seconds;
+    if (view_rot >= (2 * M_PI)) {
+        view_rot -= 2 * M_PI;
     }
 }
 
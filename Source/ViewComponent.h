@@ -5,13 +5,16 @@
 #ifndef INC_3D_TETRIS_VIEWCOMPONENT_H
 #define INC_3D_TETRIS_VIEWCOMPONENT_H
 
+#include "Util/GLState.h"
 #include "Util/Shader.h"
 #include "FontComponent.h"
 #include "Constants.h"
+#include "Board.h"
 
 #include <glad/glad.h>
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <glm/vec2.hpp>
@@ -19,6 +22,41 @@
 
 class Tetromino;
 
+namespace ViewComponentUtil {
+    // One cube drawn by the instanced block draw
+    struct BlockInstance {
+        float   x, y;     // Top left of the cube, in blocks
+        uint8_t color[4]; // Red, green and blue out of 255, then alpha out of 100
+    };
+
+    // Enough for the border, which is queued once to build it, and more than the two tetrominos of a frame
+    static constexpr uint32_t MAX_BLOCK_INSTANCES = 2 * (GAME_WIDTH + 2) + 2 * (GAME_HEIGHT + 2) + 8;
+
+    // A vertex of the landed stack's mesh
+    struct StackVertex {
+        float   x, y, z;
+        float   u, v;     // Run past one across merged faces, so the texture repeats once per block
+        uint8_t color[4]; // Like BlockInstance
+    };
+
+    // A row never needs more than four faces per cell, once hidden faces are left out
+    static constexpr uint32_t MAX_ROW_VERTICES = 4 * GAME_WIDTH * 6;
+
+    // The Camera uniform block: the view matrix then the projection matrix, laid out as std140
+    // Blocks and text each have their own, bound once to their own binding point
+    static constexpr GLuint     BLOCK_CAMERA_BINDING = 0;
+    static constexpr GLuint     TEXT_CAMERA_BINDING  = 1;
+    static constexpr GLsizeiptr CAMERA_SIZE    = 2 * 16 * sizeof(float);
+
+    // GL work done since the counters were last reset, to compare renderers by
+    struct RenderCounters {
+        uint32_t draw_calls;
+        uint32_t buffer_uploads; // glBufferData and glBufferSubData calls
+        uint32_t state_changes;           // Binds and enables passed on to GL
+        uint32_t redundant_state_changes; // Ones skipped for changing nothing
+    };
+}
+
 class ViewComponent {
 public:
     ViewComponent(const std::string& vert_shader_src,
@@ -27,54 +65,103 @@ public:
                   const std::string& font_src);
     ~ViewComponent();
 
-    void draw_tetromino(const Tetromino &tetromino, bool is_ghost_tetromino);
-    void draw_border();
+    // Blocks are queued and drawn together in one instanced draw,
+    // when text is drawn over them, the frame is swapped, or queueing switches between ghost and solid blocks
+    // The offset is in blocks, to draw the tetromino part of the way between two cells
+    void draw_tetromino(const Tetromino &tetromino, bool is_ghost_tetromino, glm::vec2 offset = glm::vec2(0.0f));
+
+    // Drawn straight away from a mesh kept on the GPU, which is only rebuilt in the rows that changed
+    void draw_board(const Board& board);
+    void draw_border(); // Kept on the GPU, since it never changes
     void draw_message(glm::ivec2 top_left, float scale, const std::string& msg);
 
     void swap_buffers();
     void clear_screen();
 
-    void rotate_view_left();
-    void rotate_view_right();
-    void reset_view_rotation()        { view_rot = 0.0f; }
+    // 0 swaps straight away, 1 waits for vsync, -1 waits unless the frame is already late
+    void set_swap_interval(int interval);
+    bool supports_adaptive_vsync() const;
+
+    // Turn the view by however far it goes in the given number of seconds
+    void rotate_view_left(float seconds);
+    void rotate_view_right(float seconds);
+    void reset_view_rotation();
+
+    void reset_counters();
 
     // Getters
     GLFWwindow* get_window() { return window; }
     bool should_window_close() { return glfwWindowShouldClose(window); }
+    ViewComponentUtil::RenderCounters get_counters() const;
+    std::string get_renderer_name() const; // As reported by the driver
 private:
     std::shared_ptr<FontComponent> font_component;
 
-    std::unique_ptr<Shader> shader_prog;
+    // Each pass has its own program, built from the same sources with different defines
+    enum Pass {
+        BLOCK_PASS = 0,
+        GHOST_PASS = 1, // Faded blocks, all faded by the same amount
+        TEXT_PASS  = 2,
+        NUM_PASSES = 3,
+    };
+    std::unique_ptr<Shader> shader_progs[NUM_PASSES];
     GLFWwindow* window;
 
-    // Used for rendering objects
+    // Every bind and enable made while drawing goes through here
+    Util::GLState gl_state;
+
+    // Used for rendering text
     GLuint vao;
     GLuint vbo;
-    GLuint ebo;
+
+    // Used for rendering blocks, a unit cube drawn once per instance
+    GLuint cube_vbo;
+    GLuint cube_ebo;
+    GLuint block_vao;
+    GLuint instance_vbo;
+    GLuint border_vao;
+    GLuint border_vbo;
+    uint32_t num_border_instances = 0;
 
     GLuint block_texture;
 
+    // The landed stack, with only the faces which can be seen, and faces of the same colour merged
+    // Each row has a fixed slot in the buffer, so a changed row is rebuilt without touching the rest
+    GLuint stack_vao;
+    GLuint stack_vbo;
+    BoardUtil::Cell stack_cells[BoardUtil::NUM_CELLS] = {}; // What the mesh was built from
+    ViewComponentUtil::StackVertex stack_vertices[GAME_HEIGHT][ViewComponentUtil::MAX_ROW_VERTICES];
+    GLint stack_row_first[GAME_HEIGHT];
+    GLsizei stack_row_count[GAME_HEIGHT];
+
+    void update_stack_mesh(const Board& board);
+    void mesh_stack_row(int y);
+
     glm::mat4 model_matrix;
     glm::mat4 view_matrix;
     glm::mat4 projection_matrix;
 
     // Value used to determine how much the view matrix should be rotated
     float view_rot = 0.0f;
+    bool view_changed = true; // The view matrix in the camera buffer is out of date
+
+    GLuint camera_ubo;
+    GLintptr text_camera_offset; // Where the text camera starts, after the block camera
 
-    void draw_block(const glm::ivec2 &block, uint32_t color, bool is_faded);
+    void draw_block(const glm::vec2 &block, uint32_t color, bool is_faded);
+    void flush_blocks(); // Draws every queued block
+    GLuint create_block_vao(GLuint instances); // Pairs the cube with a buffer of instances
+    void build_border(); // Queues the blocks of the border
     static constexpr int FADING_FACTOR = 50; // Expressed As Percentage
 
-    // Is this the first time ViewComponent has drawn?
-    // Used to determine whether to use glBufferData or glBufferSubData
-    bool first_iteration = true;
+    ViewComponentUtil::BlockInstance block_instances[ViewComponentUtil::MAX_BLOCK_INSTANCES];
+    uint32_t num_block_instances = 0;
+    bool queued_faded = false; // Whether the queued blocks are faded ones
 
-    // Draw mode view component is in
-    enum DrawMode {
-        GRAPHICS_MODE = 0,
-        TEXT_MODE = 1,
-        NONE = 2,
-    };
-    DrawMode draw_mode = NONE;
+    // Switches to the pass's program, and makes sure the camera is up to date
+    void use_pass(Pass pass);
+
+    ViewComponentUtil::RenderCounters counters = {0, 0, 0, 0};
 };
 
 
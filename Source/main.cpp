@@ -3,13 +3,136 @@
 //
 
 #include "Game.h"
+#include "HighScoreTable.h"
+#include "Util/Filesystem.h"
 
+#include <cstdlib>
+#include <iostream>
 #include <memory>
+#include <string>
+
+static void print_high_scores() {
+    HighScoreTable high_scores(FileSystem::getPath("highscores.log"), FileSystem::getPath("highscores.idx"));
+
+    HighScoreUtil::Record records[HIGH_SCORE_TABLE_SIZE];
+    size_t count = high_scores.read_top(records, HIGH_SCORE_TABLE_SIZE);
+    for (size_t i = 0; i < count; ++i) {
+        std::cout << (i + 1) << "\t" << records[i].score << "\t" << records[i].lines_cleared << " lines\t"
+                  << records[i].name << "\n";
+    }
+    std::cout << high_scores.get_num_records() << " games played\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::string bot_shm_name;
+    std::string bot_plugin_path;
+    double bot_time_limit = BOT_PLUGIN_TIME_LIMIT;
+    std::string record_path;
+    std::string replay_path;
+    bool new_game = false;
+    int versus_player = -1;
+    uint16_t versus_local_port = 0, versus_remote_port = 0;
+    std::string versus_host;
+    double net_latency = 0.0, net_loss = 0.0;
+    int broadcast_port = -1;
+    std::string spectate_host;
+    uint16_t spectate_port = 0;
+    FrameLimiterUtil::PresentMode present_mode = FrameLimiterUtil::PresentMode::VSYNC;
+    double target_fps = 0.0;
+    bool show_frame_stats = false;
+    std::string latency_path;
+    std::string benchmark_path;
+    uint32_t benchmark_frames = BENCHMARK_FRAMES;
+    double das = AutoShiftUtil::DEFAULT_DAS;
+    double arr = AutoShiftUtil::DEFAULT_ARR;
+
+    // Parse command line options
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--bot-shm" && i + 1 < argc) {
+            bot_shm_name = argv[++i];
+        } else if (arg == "--bot-plugin" && i + 1 < argc) {
+            bot_plugin_path = argv[++i];
+        } else if (arg == "--bot-time-limit" && i + 1 < argc) {
+            bot_time_limit = std::atof(argv[++i]) / 1000.0; // Given in milliseconds
+        } else if (arg == "--record" && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (arg == "--high-scores") {
+            print_high_scores();
+            return 0;
+        } else if (arg == "--new-game") {
+            new_game = true; // Ignore the saved game
+        } else if (arg == "--versus" && i + 4 < argc) {
+            versus_player = std::atoi(argv[++i]);
+            versus_local_port = static_cast<uint16_t>(std::atoi(argv[++i]));
+            versus_host = argv[++i];
+            versus_remote_port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        } else if (arg == "--net-latency" && i + 1 < argc) {
+            net_latency = std::atof(argv[++i]) / 1000.0; // Given in milliseconds
+        } else if (arg == "--net-loss" && i + 1 < argc) {
+            net_loss = std::atof(argv[++i]) / 100.0; // Given as a percentage
+        } else if (arg == "--present" && i + 1 < argc) {
+            if (!FrameLimiterUtil::parse_present_mode(argv[++i], present_mode)) {
+                std::cerr << "Unknown present mode, expected vsync, adaptive or uncapped\n";
+                return 1;
+            }
+        } else if (arg == "--fps" && i + 1 < argc) {
+            target_fps = std::atof(argv[++i]);
+        } else if (arg == "--frame-stats") {
+            show_frame_stats = true;
+        } else if (arg == "--das" && i + 1 < argc) {
+            das = std::atof(argv[++i]) / 1000.0; // Given in milliseconds
+        } else if (arg == "--arr" && i + 1 < argc) {
+            arr = std::atof(argv[++i]) / 1000.0;
+        } else if (arg == "--benchmark" && i + 1 < argc) {
+            benchmark_path = argv[++i];
+        } else if (arg == "--benchmark-frames" && i + 1 < argc) {
+            benchmark_frames = static_cast<uint32_t>(std::atoi(argv[++i]));
+        } else if (arg == "--latency" && i + 1 < argc) {
+            latency_path = argv[++i];
+        } else if (arg == "--broadcast" && i + 1 < argc) {
+            broadcast_port = std::atoi(argv[++i]);
+        } else if (arg == "--spectate" && i + 2 < argc) {
+            spectate_host = argv[++i];
+            spectate_port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        }
+    }
 
-int main() {
     Game game;
+    if (!benchmark_path.empty()) {
+        game.benchmark(benchmark_path, benchmark_frames);
+        return 0;
+    }
+    game.set_present_mode(present_mode, target_fps, show_frame_stats);
+    game.set_auto_shift(das, arr);
+    if (!latency_path.empty()) {
+        game.measure_latency(latency_path);
+    }
+    if (!bot_shm_name.empty()) {
+        game.attach_bot_bridge(bot_shm_name);
+    }
+    if (!bot_plugin_path.empty()) {
+        game.attach_bot_plugin(bot_plugin_path, bot_time_limit);
+    }
+    if (!record_path.empty()) {
+        game.start_recording(record_path);
+    }
+    if (broadcast_port >= 0) {
+        game.start_broadcast(static_cast<uint16_t>(broadcast_port));
+    }
+    if (!spectate_host.empty()) {
+        game.start_spectating(spectate_host, spectate_port);
+    } else if (versus_player >= 0) {
+        game.start_versus(static_cast<unsigned int>(versus_player), versus_local_port, versus_host,
+                          versus_remote_port, net_latency, net_loss);
+    } else if (!replay_path.empty()) {
+        game.start_playback(replay_path);
+    } else if (!new_game) {
+        game.resume_saved_game();
+    }
     game.begin();
 
     return 0;
 }
-
@@ -0,0 +1,232 @@
+// Drives a MatchServer on a loopback port with real client sockets
+// The server runs on this thread between steps, so everything it sends is already waiting when read
+
+#include "MatchServer.h"
+#include "TestUtil.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+namespace {
+    // Long enough for a few ticks, and for connections and messages to be handled
+    constexpr double SETTLE_SECONDS = 0.1;
+
+    int connect_client(uint16_t port) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        // Loopback connections complete in the listen backlog, before the server accepts them
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    void send_message(int fd, MatchProtocol::ClientMessageType type, SimulationUtil::Input input) {
+        MatchProtocol::ClientMessage message = {type, static_cast<uint8_t>(input)};
+        send(fd, &message, sizeof(message), MSG_NOSIGNAL);
+    }
+
+    enum ReadResult {
+        READ_MESSAGE,
+        READ_NOTHING, // Nothing waiting
+        READ_CLOSED,  // The server closed the connection
+    };
+
+    ReadResult read_message(int fd, MatchProtocol::ServerMessage& message) {
+        ssize_t received = recv(fd, &message, sizeof(message), MSG_DONTWAIT);
+        if (received == 0) {
+            return READ_CLOSED;
+        }
+        if (received < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? READ_NOTHING : READ_CLOSED;
+        }
+        CHECK(received == sizeof(message)); // Loopback never splits a message this small
+        return READ_MESSAGE;
+    }
+
+    // Every update waiting on the connection, with their events merged
+    uint32_t read_updates(int fd, uint32_t& count) {
+        uint32_t events = 0;
+        count = 0;
+        MatchProtocol::ServerMessage message;
+        while (read_message(fd, message) == READ_MESSAGE) {
+            CHECK(message.type == MatchProtocol::SERVER_UPDATE);
+            events |= message.events;
+            ++count;
+        }
+        return events;
+    }
+
+    void test_match_setup(MatchServer& server, std::vector<int>& clients, std::vector<uint32_t>& seeds) {
+        for (int i = 0; i < 3; ++i) {
+            clients.push_back(connect_client(server.get_port()));
+            CHECK(clients.back() != -1);
+        }
+        server.run_for(SETTLE_SECONDS);
+        CHECK(server.get_num_matches() == 3);
+
+        for (int fd : clients) {
+            MatchProtocol::ServerMessage welcome;
+            CHECK(read_message(fd, welcome) == READ_MESSAGE);
+            CHECK(welcome.type == MatchProtocol::SERVER_WELCOME);
+            CHECK(welcome.game_over == 0);
+            CHECK(welcome.score == 0);
+            seeds.push_back(welcome.seed);
+        }
+        CHECK(seeds[0] != seeds[1] && seeds[1] != seeds[2] && seeds[0] != seeds[2]);
+
+        // The server is full, so anyone else is turned away
+        int extra = connect_client(server.get_port());
+        server.run_for(SETTLE_SECONDS);
+        MatchProtocol::ServerMessage message;
+        CHECK(read_message(extra, message) == READ_CLOSED);
+        CHECK(server.get_num_matches() == 3);
+        close(extra);
+    }
+
+    void test_input_relay(MatchServer& server, const std::vector<int>& clients, std::vector<uint32_t>& seeds) {
+        uint32_t count;
+        read_updates(clients[0], count);
+        read_updates(clients[1], count);
+
+        // Only the game of the client which dropped should land
+        send_message(clients[0], MatchProtocol::CLIENT_INPUT, SimulationUtil::Input::HARD_DROP);
+        server.run_for(SETTLE_SECONDS);
+        uint32_t events = read_updates(clients[0], count);
+        CHECK(count > 0);
+        CHECK(events & SimulationUtil::EVENT_LANDED);
+        CHECK(events & SimulationUtil::EVENT_SPAWNED);
+        CHECK(!(read_updates(clients[1], count) & SimulationUtil::EVENT_LANDED));
+
+        // Moves which work are reported as well
+        send_message(clients[1], MatchProtocol::CLIENT_INPUT, SimulationUtil::Input::LEFT);
+        server.run_for(SETTLE_SECONDS);
+        CHECK(read_updates(clients[1], count) & SimulationUtil::EVENT_MOVED);
+
+        // Inputs outside the protocol's range are ignored rather than applied
+        send_message(clients[1], MatchProtocol::CLIENT_INPUT, static_cast<SimulationUtil::Input>(SimulationUtil::NUM_INPUTS));
+        server.run_for(SETTLE_SECONDS);
+        CHECK(server.get_num_matches() == 3);
+
+        // A reset starts a new game with a new seed
+        send_message(clients[0], MatchProtocol::CLIENT_RESET, SimulationUtil::Input::NONE);
+        server.run_for(SETTLE_SECONDS);
+        MatchProtocol::ServerMessage welcome;
+        bool welcomed = false;
+        while (read_message(clients[0], welcome) == READ_MESSAGE) {
+            if (welcome.type == MatchProtocol::SERVER_WELCOME) {
+                welcomed = true;
+                CHECK(welcome.seed != seeds[0]);
+                CHECK(welcome.score == 0);
+                seeds[0] = welcome.seed;
+            }
+        }
+        CHECK(welcomed);
+    }
+
+    void test_teardown(MatchServer& server, std::vector<int>& clients) {
+        // Anything outside the protocol closes the connection and frees the game
+        MatchProtocol::ClientMessage garbage = {0xFF, 0};
+        send(clients[2], &garbage, sizeof(garbage), MSG_NOSIGNAL);
+        server.run_for(SETTLE_SECONDS);
+        MatchProtocol::ServerMessage message;
+        while (read_message(clients[2], message) == READ_MESSAGE) {
+        }
+        CHECK(read_message(clients[2], message) == READ_CLOSED);
+        CHECK(server.get_num_matches() == 2);
+        close(clients[2]);
+
+        // Hanging up frees the game too, and the slot goes to the next client
+        close(clients[1]);
+        server.run_for(SETTLE_SECONDS);
+        CHECK(server.get_num_matches() == 1);
+
+        clients[1] = connect_client(server.get_port());
+        server.run_for(SETTLE_SECONDS);
+        CHECK(read_message(clients[1], message) == READ_MESSAGE);
+        CHECK(message.type == MatchProtocol::SERVER_WELCOME);
+        CHECK(server.get_num_matches() == 2);
+
+        close(clients[0]);
+        close(clients[1]);
+        server.run_for(SETTLE_SECONDS);
+        CHECK(server.get_num_matches() == 0);
+    }
+
+    // Clients keep coming when the server is out of descriptors, so it closes them rather than leaving them waiting,
+    // and goes back to sleeping between ticks rather than waking for them over and over
+    void test_descriptor_exhaustion() {
+        rlimit original;
+        CHECK(getrlimit(RLIMIT_NOFILE, &original) == 0);
+
+        MatchServer server(0, 100, 1);
+        server.set_print_reports(false);
+
+        // Clients and server share this process's descriptors, so the clients use up all but none
+        int first = connect_client(server.get_port());
+        CHECK(first != -1);
+        rlimit lowered = original;
+        lowered.rlim_cur = static_cast<rlim_t>(first) + 9;
+        CHECK(setrlimit(RLIMIT_NOFILE, &lowered) == 0);
+
+        std::vector<int> clients = {first};
+        int fd;
+        while ((fd = connect_client(server.get_port())) != -1) {
+            clients.push_back(fd);
+        }
+        CHECK(clients.size() > 2);
+
+        std::clock_t cpu_start = std::clock();
+        server.run_for(SETTLE_SECONDS);
+        CHECK(server.get_num_matches() == 0);
+        MatchProtocol::ServerMessage message;
+        for (int client : clients) {
+            CHECK(read_message(client, message) == READ_CLOSED);
+        }
+
+        // Only the ticks should have run, not a loop waking on the listen socket
+        server.run_for(SETTLE_SECONDS * 3);
+        double cpu_seconds = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        CHECK(cpu_seconds < SETTLE_SECONDS * 2);
+
+        // Once descriptors are free, clients get in again
+        for (int client : clients) {
+            close(client);
+        }
+        int late = connect_client(server.get_port());
+        server.run_for(SETTLE_SECONDS);
+        CHECK(read_message(late, message) == READ_MESSAGE);
+        CHECK(message.type == MatchProtocol::SERVER_WELCOME);
+        close(late);
+
+        setrlimit(RLIMIT_NOFILE, &original);
+    }
+}
+
+int main() {
+    MatchServer server(0, 3, 1);
+    server.set_print_reports(false);
+    CHECK(server.get_port() != 0);
+
+    std::vector<int> clients;
+    std::vector<uint32_t> seeds;
+    test_match_setup(server, clients, seeds);
+    test_input_relay(server, clients, seeds);
+    test_teardown(server, clients);
+    test_descriptor_exhaustion();
+
+    return TestUtil::result();
+}
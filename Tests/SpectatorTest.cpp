@@ -0,0 +1,228 @@
+// Broadcasts a replay over loopback through SpectatorServer, and checks every decoded frame
+// against the simulation it was taken from
+//
+// spectator-test [game.replay]
+// Without a replay, one is recorded first from random inputs
+
+#include "Replay.h"
+#include "SpectatorLink.h"
+#include "TestUtil.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr uint32_t RECORDED_TICKS = 20 * FPS; // Twenty seconds of play
+    constexpr uint32_t INPUT_CHANCE = 8; // One input every this many ticks, roughly a player's pace
+
+    using Clock = std::chrono::steady_clock;
+
+    // Plays random inputs, starting a new game whenever one ends
+    void record_replay(const std::string& path) {
+        Simulation simulation;
+        simulation.reset(1);
+        ReplayWriter writer(path, REPLAY_KEYFRAME_INTERVAL);
+
+        RandomNumberUtil::MinStdEngine inputs;
+        inputs.seed(1);
+        for (uint32_t tick = 0; tick < RECORDED_TICKS; ++tick) {
+            if (simulation.is_game_over()) {
+                simulation.reset(simulation.get_seed() + 1);
+                writer.force_keyframe();
+            }
+            writer.begin_tick(simulation);
+
+            SimulationUtil::Input input = SimulationUtil::Input::NONE;
+            if (inputs() % INPUT_CHANCE == 0) {
+                input = static_cast<SimulationUtil::Input>(1 + inputs() % (SimulationUtil::NUM_INPUTS - 1));
+                writer.record_input(input);
+            }
+            simulation.tick(&input, input == SimulationUtil::Input::NONE ? 0 : 1);
+            writer.end_tick();
+        }
+    }
+
+    int connect_spectator(uint16_t port) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Only what is streamed has to match, the rest of the state is left behind on purpose
+    bool same_view(const SimulationUtil::State& a, const SimulationUtil::State& b) {
+        return std::memcmp(a.cells, b.cells, sizeof(a.cells)) == 0 &&
+               std::memcmp(&a.current, &b.current, sizeof(a.current)) == 0 &&
+               std::memcmp(a.next_queue, b.next_queue, sizeof(a.next_queue)) == 0 &&
+               a.game_over == b.game_over && a.score == b.score && a.lines_cleared == b.lines_cleared;
+    }
+
+    // Reads whatever the server sent, and decodes each whole frame in it, timing every decode
+    void receive_frames(int fd, std::vector<uint8_t>& input, SpectatorDecoder& decoder,
+                        std::vector<double>& decode_us, uint64_t& bytes) {
+        uint8_t buffer[4096];
+        ssize_t received;
+        while ((received = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            input.insert(input.end(), buffer, buffer + received);
+            bytes += static_cast<uint64_t>(received);
+        }
+
+        size_t offset = 0;
+        while (input.size() - offset >= sizeof(SpectatorUtil::FrameSize)) {
+            SpectatorUtil::FrameSize size;
+            std::memcpy(&size, &input[offset], sizeof(size));
+            if (input.size() - offset - sizeof(size) < size) {
+                break;
+            }
+
+            Clock::time_point start = Clock::now();
+            bool decoded = decoder.decode(&input[offset + sizeof(size)], size);
+            decode_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            CHECK(decoded);
+            offset += sizeof(size) + size;
+        }
+        input.erase(input.begin(), input.begin() + offset);
+    }
+
+    // Out of range types, rotations and cells would index past the end of tables when drawn, so they are refused
+    void test_malformed_frames() {
+        using namespace SpectatorUtil;
+
+        Simulation source;
+        source.reset(1);
+        const SimulationUtil::State good = source.save_state();
+        SpectatorEncoder encoder;
+        std::vector<uint8_t> frame;
+        encoder.encode_keyframe(good, frame);
+
+        SpectatorDecoder decoder;
+        auto decode = [&](const std::vector<uint8_t>& whole) {
+            return decoder.decode(whole.data() + sizeof(FrameSize), whole.size() - sizeof(FrameSize));
+        };
+        auto keyframe_with = [&](void (*corrupt)(SimulationUtil::State&)) {
+            SimulationUtil::State bad = good;
+            corrupt(bad);
+            std::vector<uint8_t> out = frame;
+            std::memcpy(&out[sizeof(FrameSize) + 1], &bad, sizeof(bad));
+            return out;
+        };
+
+        CHECK(!decode(keyframe_with([](SimulationUtil::State& s) { s.current.type = TetrominoUtil::NUM_TYPES; })));
+        CHECK(!decode(keyframe_with([](SimulationUtil::State& s) { s.current.rotation_state = 4; })));
+        CHECK(!decode(keyframe_with([](SimulationUtil::State& s) { s.current.state = 2; })));
+        CHECK(!decode(keyframe_with([](SimulationUtil::State& s) { s.next_queue[0] = 0xFF; })));
+        CHECK(!decode(keyframe_with([](SimulationUtil::State& s) { s.cells[0] = TetrominoUtil::NUM_TYPES + 1; })));
+        CHECK(!decoder.has_keyframe());
+
+        CHECK(decode(frame));
+        CHECK(decoder.has_keyframe());
+
+        // A delta moving the tetromino to a type which does not exist leaves the last good state alone
+        std::vector<uint8_t> delta;
+        delta.clear();
+        SimulationUtil::State moved = good;
+        moved.current.top_left[0] = static_cast<int8_t>(moved.current.top_left[0] + 1);
+        encoder.encode_delta(moved, delta);
+        CHECK(delta[sizeof(FrameSize)] & FLAG_POSE);
+        size_t pose_offset = delta.size() - sizeof(TetrominoUtil::Pose);
+        delta[pose_offset] = 0xFF; // Pose::type is its first byte
+        CHECK(!decode(delta));
+        CHECK(same_view(decoder.get_simulation().save_state(), good));
+
+        // An idle tick is the flags byte and the size prefix
+        std::vector<uint8_t> idle;
+        SpectatorEncoder idle_encoder;
+        idle_encoder.encode_keyframe(good, idle);
+        idle.clear();
+        idle_encoder.encode_delta(good, idle);
+        CHECK(idle.size() == sizeof(FrameSize) + 1);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    test_malformed_frames();
+
+    std::string replay_path = "spectator-test.replay";
+    if (argc > 1) {
+        replay_path = argv[1];
+    } else {
+        record_replay(replay_path);
+    }
+
+    ReplayReader reader(replay_path);
+    Simulation source;
+    reader.seek(source, 0);
+
+    SpectatorServer server(0);
+    CHECK(server.get_port() != 0);
+
+    // One spectator decoding by hand so each frame can be timed, and one going through SpectatorClient
+    int fd = connect_spectator(server.get_port());
+    CHECK(fd != -1);
+    SpectatorClient client("127.0.0.1", server.get_port());
+
+    SpectatorDecoder decoder;
+    std::vector<uint8_t> input;
+    std::vector<double> decode_us;
+    uint64_t bytes = 0;
+    uint32_t frames = 0;
+    uint32_t mismatches = 0;
+
+    // The first publish accepts both spectators and sends them a keyframe, every tick after is a delta
+    do {
+        server.publish(source.save_state());
+        ++frames;
+
+        // Loopback delivers the frame before publish returns, so each frame is decoded before the next is sent
+        receive_frames(fd, input, decoder, decode_us, bytes);
+        client.poll();
+
+        SimulationUtil::State expected = source.save_state();
+        if (!same_view(decoder.get_simulation().save_state(), expected) ||
+            !same_view(client.get_simulation().save_state(), expected)) {
+            ++mismatches;
+        }
+    } while (reader.step(source));
+
+    CHECK(server.get_num_spectators() == 2);
+    CHECK(client.is_connected());
+    CHECK(decode_us.size() == frames);
+    CHECK(mismatches == 0);
+    CHECK(frames == reader.get_num_ticks() + 1);
+
+    std::vector<double> sorted = decode_us;
+    std::sort(sorted.begin(), sorted.end());
+    double mean = 0.0;
+    for (double us : sorted) {
+        mean += us;
+    }
+    mean /= std::max<size_t>(sorted.size(), 1);
+    size_t p99 = std::min(sorted.size() - 1, static_cast<size_t>(0.99 * sorted.size()));
+
+    std::cout << frames << " frames, " << bytes << " bytes, "
+              << static_cast<double>(bytes) * FPS / frames << " bytes/s at " << FPS << " ticks/s\n"
+              << "Decode: mean " << mean << "us, p99 " << sorted[p99] << "us, max " << sorted.back() << "us\n";
+
+    close(fd);
+    if (argc <= 1) {
+        std::remove(replay_path.c_str());
+    }
+    return TestUtil::result();
+}
@@ -0,0 +1,33 @@
+// Minimal checks for the test programs, which are plain executables run by ctest
+// A failed check is reported and counted, and the program carries on so every failure shows up
+
+#ifndef INC_3D_TETRIS_TESTUTIL_H
+#define INC_3D_TETRIS_TESTUTIL_H
+
+#include <iostream>
+
+namespace TestUtil {
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+
+    // Exit code for main
+    inline int result() {
+        if (failures() != 0) {
+            std::cerr << failures() << " checks failed\n";
+            return 1;
+        }
+        return 0;
+    }
+}
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            ++TestUtil::failures();                                                        \
+        }                                                                                  \
+    } while (false)
+
+#endif //INC_3D_TETRIS_TESTUTIL_H
@@ -0,0 +1,168 @@
+#include "Huffman.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <utility>
+
+void Huffman::build_code_lengths(const uint64_t frequencies[NUM_SYMBOLS], uint8_t lengths[NUM_SYMBOLS]) {
+    std::vector<uint64_t> weights(frequencies, frequencies + NUM_SYMBOLS);
+
+    while (true) {
+        std::memset(lengths, 0, NUM_SYMBOLS);
+
+        // Nodes 0 to 255 are the symbols, the rest are merged nodes
+        using Node = std::pair<uint64_t, int>;
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+        std::vector<int> parents(NUM_SYMBOLS * 2, -1);
+        for (unsigned int s = 0; s < NUM_SYMBOLS; ++s) {
+            if (weights[s] != 0) {
+                queue.push(Node(weights[s], s));
+            }
+        }
+        if (queue.empty()) {
+            return;
+        }
+        if (queue.size() == 1) {
+            lengths[queue.top().second] = 1; // A lone symbol still needs a code
+            return;
+        }
+
+        int next_node = NUM_SYMBOLS;
+        while (queue.size() > 1) {
+            Node a = queue.top();
+            queue.pop();
+            Node b = queue.top();
+            queue.pop();
+            parents[a.second] = next_node;
+            parents[b.second] = next_node;
+            queue.push(Node(a.first + b.first, next_node++));
+        }
+
+        // A symbol's code length is its depth in the tree
+        bool too_long = false;
+        for (unsigned int s = 0; s < NUM_SYMBOLS; ++s) {
+            if (weights[s] == 0) {
+                continue;
+            }
+            unsigned int depth = 0;
+            for (int node = s; parents[node] != -1; node = parents[node]) {
+                ++depth;
+            }
+            lengths[s] = static_cast<uint8_t>(std::min(depth, 255u));
+            too_long |= (depth > MAX_CODE_LENGTH);
+        }
+        if (!too_long) {
+            return;
+        }
+
+        // Flatten the distribution and try again until every code fits
+        for (auto& weight : weights) {
+            if (weight != 0) {
+                weight = (weight + 1) / 2;
+            }
+        }
+    }
+}
+
+// Encoder
+// -------
+
+Huffman::Encoder::Encoder(const uint8_t lengths[NUM_SYMBOLS]) {
+    std::memcpy(code_lengths, lengths, NUM_SYMBOLS);
+    std::memset(codes, 0, sizeof(codes));
+
+    // Canonical codes are handed out in order of length, then symbol
+    uint16_t length_counts[MAX_CODE_LENGTH + 1] = {};
+    for (unsigned int s = 0; s < NUM_SYMBOLS; ++s) {
+        ++length_counts[lengths[s]];
+    }
+    length_counts[0] = 0;
+
+    uint16_t next_code[MAX_CODE_LENGTH + 1] = {};
+    uint16_t code = 0;
+    for (unsigned int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+        code = static_cast<uint16_t>((code + length_counts[length - 1]) << 1);
+        next_code[length] = code;
+    }
+    for (unsigned int s = 0; s < NUM_SYMBOLS; ++s) {
+        if (lengths[s] != 0) {
+            codes[s] = next_code[lengths[s]]++;
+        }
+    }
+}
+
+void Huffman::Encoder::encode(const uint8_t* symbols, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        write_bits(codes[symbols[i]], code_lengths[symbols[i]]);
+    }
+}
+
+void Huffman::Encoder::write_bits(uint32_t value, unsigned int length) {
+    for (int bit = static_cast<int>(length) - 1; bit >= 0; --bit) {
+        if ((num_bits & 7) == 0) {
+            bytes.push_back(0);
+        }
+        if ((value >> bit) & 1) {
+            bytes.back() |= static_cast<uint8_t>(0x80 >> (num_bits & 7));
+        }
+        ++num_bits;
+    }
+}
+
+// Decoder
+// -------
+
+Huffman::Decoder::Decoder(const uint8_t lengths[NUM_SYMBOLS]) {
+    std::memset(length_counts, 0, sizeof(length_counts));
+    for (unsigned int s = 0; s < NUM_SYMBOLS; ++s) {
+        if (lengths[s] <= MAX_CODE_LENGTH) {
+            ++length_counts[lengths[s]];
+        }
+    }
+    length_counts[0] = 0;
+
+    // Symbols sorted by length then value, the order the codes were handed out in
+    uint16_t offsets[MAX_CODE_LENGTH + 2] = {};
+    for (unsigned int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+        offsets[length + 1] = offsets[length] + length_counts[length];
+    }
+    std::memset(sorted_symbols, 0, sizeof(sorted_symbols));
+    for (unsigned int s = 0; s < NUM_SYMBOLS; ++s) {
+        if (lengths[s] != 0 && lengths[s] <= MAX_CODE_LENGTH) {
+            sorted_symbols[offsets[lengths[s]]++] = static_cast<uint8_t>(s);
+        }
+    }
+}
+
+bool Huffman::Decoder::decode(const uint8_t* stream, uint64_t stream_bits, uint64_t bit_offset,
+                              uint8_t* symbols, size_t count) const {
+    for (size_t i = 0; i < count; ++i) {
+        int code = 0;   // Bits read so far
+        int first = 0;  // First code of the current length
+        int index = 0;  // Index of the first symbol of the current length
+        bool found = false;
+        for (unsigned int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+            if (bit_offset >= stream_bits) {
+                return false;
+            }
+            code |= (stream[bit_offset >> 3] >> (7 - (bit_offset & 7))) & 1;
+            ++bit_offset;
+
+            int length_count = length_counts[length];
+            if (code - first < length_count) {
+                symbols[i] = sorted_symbols[index + (code - first)];
+                found = true;
+                break;
+            }
+            index += length_count;
+            first = (first + length_count) << 1;
+            code <<= 1;
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+// Canonical Huffman coding of bytes
+// Only the code length of each symbol needs to be stored to rebuild the codes
+
+#ifndef INC_3D_TETRIS_HUFFMAN_H
+#define INC_3D_TETRIS_HUFFMAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Huffman {
+    static constexpr unsigned int NUM_SYMBOLS = 256;
+    static constexpr unsigned int MAX_CODE_LENGTH = 15;
+
+    // Symbols which never occur get a length of zero
+    void build_code_lengths(const uint64_t frequencies[NUM_SYMBOLS], uint8_t lengths[NUM_SYMBOLS]);
+
+    // Appends codes to a growing bit stream, most significant bit first
+    class Encoder {
+    public:
+        explicit Encoder(const uint8_t lengths[NUM_SYMBOLS]);
+
+        void encode(const uint8_t* symbols, size_t count);
+
+        uint64_t bit_offset() const { return num_bits; }
+        const std::vector<uint8_t>& get_bytes() const { return bytes; }
+    private:
+        void write_bits(uint32_t value, unsigned int length);
+
+        uint16_t codes[NUM_SYMBOLS];
+        uint8_t code_lengths[NUM_SYMBOLS];
+
+        std::vector<uint8_t> bytes;
+        uint64_t num_bits = 0;
+    };
+
+    // Decodes from anywhere in a bit stream, without needing to start at the beginning
+    class Decoder {
+    public:
+        explicit Decoder(const uint8_t lengths[NUM_SYMBOLS]);
+
+        // Returns false if the stream ends or holds an invalid code
+        bool decode(const uint8_t* stream, uint64_t stream_bits, uint64_t bit_offset,
+                    uint8_t* symbols, size_t count) const;
+    private:
+        // Canonical codes of each length are consecutive, so a code is found by
+        // its distance from the first code of its length
+        uint16_t length_counts[MAX_CODE_LENGTH + 1];
+        uint8_t sorted_symbols[NUM_SYMBOLS];
+    };
+}
+
+#endif //INC_3D_TETRIS_HUFFMAN_H
@@ -0,0 +1,285 @@
+#include "ReplayCorpus.h"
+#include "Replay.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    uint64_t hash_chunk(uint32_t parent, const uint8_t* bytes, size_t size) {
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (int i = 0; i < 4; ++i) {
+            hash = (hash ^ ((parent >> (i * 8)) & 0xFF)) * 1099511628211ull;
+        }
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::vector<uint8_t> encode_inputs(const std::vector<CorpusUtil::InputEvent>& inputs) {
+        std::vector<uint8_t> bytes;
+        uint32_t previous_tick = 0;
+        for (auto& event : inputs) {
+            uint8_t varint[5];
+            uint32_t value = ((event.tick - previous_tick) << 3) | static_cast<uint32_t>(event.input);
+            size_t length = ReplayUtil::encode_varint(value, varint);
+            bytes.insert(bytes.end(), varint, varint + length);
+            previous_tick = event.tick;
+        }
+        return bytes;
+    }
+}
+
+// Corpus writer
+// -------------
+
+uint32_t CorpusWriter::Stream::add(const std::vector<uint8_t>& bytes) {
+    uint32_t parent = CorpusUtil::NO_CHUNK;
+    for (size_t start = 0; start < bytes.size(); start += CorpusUtil::CHUNK_SYMBOLS) {
+        size_t length = std::min<size_t>(CorpusUtil::CHUNK_SYMBOLS, bytes.size() - start);
+        const uint8_t* chunk_start = bytes.data() + start;
+
+        // Reuse the chunk if an identical one hangs off the same parent
+        uint64_t hash = hash_chunk(parent, chunk_start, length);
+        uint32_t found = CorpusUtil::NO_CHUNK;
+        auto& candidates = lookup[hash];
+        for (uint32_t candidate : candidates) {
+            auto& existing = chunk_bytes[candidate];
+            if (chunks[candidate].parent == parent && existing.size() == length &&
+                std::equal(existing.begin(), existing.end(), chunk_start)) {
+                found = candidate;
+                break;
+            }
+        }
+
+        if (found == CorpusUtil::NO_CHUNK) {
+            found = static_cast<uint32_t>(chunks.size());
+            chunks.push_back(CorpusUtil::Chunk{parent, static_cast<uint32_t>(length), 0});
+            chunk_bytes.emplace_back(chunk_start, chunk_start + length);
+            candidates.push_back(found);
+        } else {
+            ++shared;
+        }
+        parent = found;
+    }
+
+    heads.push_back(parent);
+    return parent;
+}
+
+void CorpusWriter::add_game(uint32_t seed, const CorpusUtil::GameStats& game_stats,
+                            const std::vector<CorpusUtil::InputEvent>& inputs,
+                            const std::vector<uint8_t>& pieces) {
+    seeds.push_back(seed);
+    stats.push_back(game_stats);
+
+    // Equal inputs encode to equal bytes, so prefixes can be matched on the encoded stream
+    input_stream.add(encode_inputs(inputs));
+    piece_stream.add(pieces);
+}
+
+void CorpusWriter::write(const std::string& path) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error(std::string("fatal error: Failed to open corpus for writing\nCorpus path: ") + path);
+    }
+
+    // Every column is built in memory first, then laid out after the header
+    std::vector<std::vector<uint8_t>> columns(CorpusUtil::NUM_COLUMNS);
+    auto put = [&columns](CorpusUtil::Column column, const void* bytes, size_t size) {
+        const uint8_t* start = static_cast<const uint8_t*>(bytes);
+        columns[column].insert(columns[column].end(), start, start + size);
+    };
+
+    put(CorpusUtil::COLUMN_SEEDS, seeds.data(), seeds.size() * sizeof(uint32_t));
+    put(CorpusUtil::COLUMN_STATS, stats.data(), stats.size() * sizeof(CorpusUtil::GameStats));
+
+    const Stream* streams[2] = {&input_stream, &piece_stream};
+    const CorpusUtil::Column heads_columns[2] = {CorpusUtil::COLUMN_INPUT_HEADS, CorpusUtil::COLUMN_PIECE_HEADS};
+    for (int s = 0; s < 2; ++s) {
+        const Stream& stream = *streams[s];
+
+        // One code table for the whole column, so it is only stored once
+        uint64_t frequencies[Huffman::NUM_SYMBOLS] = {};
+        for (auto& bytes : stream.chunk_bytes) {
+            for (uint8_t byte : bytes) {
+                ++frequencies[byte];
+            }
+        }
+        CorpusUtil::StreamHeader stream_header;
+        Huffman::build_code_lengths(frequencies, stream_header.code_lengths);
+
+        Huffman::Encoder encoder(stream_header.code_lengths);
+        std::vector<CorpusUtil::Chunk> chunks = stream.chunks;
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            chunks[c].bit_offset = encoder.bit_offset();
+            encoder.encode(stream.chunk_bytes[c].data(), stream.chunk_bytes[c].size());
+        }
+        stream_header.num_bits = encoder.bit_offset();
+
+        put(heads_columns[s], stream.heads.data(), stream.heads.size() * sizeof(uint32_t));
+        put(static_cast<CorpusUtil::Column>(heads_columns[s] + 1), chunks.data(), chunks.size() * sizeof(CorpusUtil::Chunk));
+        put(static_cast<CorpusUtil::Column>(heads_columns[s] + 2), &stream_header, sizeof(stream_header));
+        put(static_cast<CorpusUtil::Column>(heads_columns[s] + 2), encoder.get_bytes().data(), encoder.get_bytes().size());
+    }
+
+    CorpusUtil::Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CorpusUtil::MAGIC, sizeof(header.magic));
+    header.version = CorpusUtil::VERSION;
+    header.num_games = static_cast<uint32_t>(seeds.size());
+
+    uint64_t offset = sizeof(header);
+    for (unsigned int c = 0; c < CorpusUtil::NUM_COLUMNS; ++c) {
+        offset = (offset + 7) & ~static_cast<uint64_t>(7); // Keep columns aligned for reading in place
+        header.columns[c].offset = offset;
+        header.columns[c].size = columns[c].size();
+        offset += columns[c].size();
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t written = sizeof(header);
+    for (unsigned int c = 0; c < CorpusUtil::NUM_COLUMNS; ++c) {
+        static const char zeros[8] = {};
+        file.write(zeros, header.columns[c].offset - written);
+        file.write(reinterpret_cast<const char*>(columns[c].data()), columns[c].size());
+        written = header.columns[c].offset + columns[c].size();
+    }
+
+    if (!file) {
+        throw std::runtime_error(std::string("fatal error: Failed to write corpus\nCorpus path: ") + path);
+    }
+}
+
+// Corpus reader
+// -------------
+
+CorpusReader::CorpusReader(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error(std::string("fatal error: Failed to open corpus\nCorpus path: ") + path);
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || file_stat.st_size < static_cast<off_t>(sizeof(CorpusUtil::Header))) {
+        close(fd);
+        throw std::runtime_error(std::string("fatal error: Corpus is truncated\nCorpus path: ") + path);
+    }
+    size = static_cast<size_t>(file_stat.st_size);
+
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error(std::string("fatal error: Failed to map corpus\nCorpus path: ") + path);
+    }
+    data = static_cast<const uint8_t*>(mapping);
+
+    std::memcpy(&header, data, sizeof(header));
+    bool valid = std::memcmp(header.magic, CorpusUtil::MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == CorpusUtil::VERSION;
+    for (unsigned int c = 0; valid && c < CorpusUtil::NUM_COLUMNS; ++c) {
+        valid = header.columns[c].offset + header.columns[c].size <= size;
+    }
+    valid = valid &&
+            header.columns[CorpusUtil::COLUMN_SEEDS].size == header.num_games * sizeof(uint32_t) &&
+            header.columns[CorpusUtil::COLUMN_STATS].size == header.num_games * sizeof(CorpusUtil::GameStats);
+    if (!valid) {
+        munmap(mapping, size);
+        throw std::runtime_error(std::string("fatal error: Corpus is corrupt or from another version\nCorpus path: ") + path);
+    }
+
+    seeds = reinterpret_cast<const uint32_t*>(data + header.columns[CorpusUtil::COLUMN_SEEDS].offset);
+    stats = reinterpret_cast<const CorpusUtil::GameStats*>(data + header.columns[CorpusUtil::COLUMN_STATS].offset);
+}
+
+CorpusReader::~CorpusReader() {
+    munmap(const_cast<uint8_t*>(data), size);
+}
+
+std::vector<uint8_t> CorpusReader::decode_stream(CorpusUtil::Column heads_column, uint32_t game) const {
+    const CorpusUtil::ColumnEntry& heads_entry = header.columns[heads_column];
+    const CorpusUtil::ColumnEntry& chunks_entry = header.columns[heads_column + 1];
+    const CorpusUtil::ColumnEntry& data_entry = header.columns[heads_column + 2];
+
+    const uint32_t* heads = reinterpret_cast<const uint32_t*>(data + heads_entry.offset);
+    const CorpusUtil::Chunk* chunks = reinterpret_cast<const CorpusUtil::Chunk*>(data + chunks_entry.offset);
+    uint32_t num_chunks = static_cast<uint32_t>(chunks_entry.size / sizeof(CorpusUtil::Chunk));
+    if (game >= heads_entry.size / sizeof(uint32_t) || data_entry.size < sizeof(CorpusUtil::StreamHeader)) {
+        throw std::runtime_error("fatal error: Corpus stream is corrupt");
+    }
+
+    // The chunks are linked from the last one back to the first
+    std::vector<uint32_t> chain;
+    for (uint32_t chunk = heads[game]; chunk != CorpusUtil::NO_CHUNK; chunk = chunks[chunk].parent) {
+        if (chunk >= num_chunks || chain.size() > num_chunks) {
+            throw std::runtime_error("fatal error: Corpus stream is corrupt");
+        }
+        chain.push_back(chunk);
+    }
+
+    // Nothing from the file is trusted to stay inside the mapping or to be a sensible size
+    CorpusUtil::StreamHeader stream_header;
+    std::memcpy(&stream_header, data + data_entry.offset, sizeof(stream_header));
+    bool valid = stream_header.num_bits <= (data_entry.size - sizeof(stream_header)) * 8;
+    for (uint8_t length : stream_header.code_lengths) {
+        valid = valid && length <= Huffman::MAX_CODE_LENGTH;
+    }
+    if (!valid) {
+        throw std::runtime_error("fatal error: Corpus stream is corrupt");
+    }
+    const uint8_t* coded = data + data_entry.offset + sizeof(stream_header);
+    Huffman::Decoder decoder(stream_header.code_lengths);
+
+    std::vector<uint8_t> bytes;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        const CorpusUtil::Chunk& chunk = chunks[*it];
+        if (chunk.raw_size > CorpusUtil::CHUNK_SYMBOLS) {
+            throw std::runtime_error("fatal error: Corpus stream is corrupt");
+        }
+        size_t start = bytes.size();
+        bytes.resize(start + chunk.raw_size);
+        if (!decoder.decode(coded, stream_header.num_bits, chunk.bit_offset, &bytes[start], chunk.raw_size)) {
+            throw std::runtime_error("fatal error: Corpus stream is corrupt");
+        }
+    }
+    return bytes;
+}
+
+std::vector<CorpusUtil::InputEvent> CorpusReader::decode_inputs(uint32_t game) const {
+    std::vector<uint8_t> bytes = decode_stream(CorpusUtil::COLUMN_INPUT_HEADS, game);
+
+    std::vector<CorpusUtil::InputEvent> inputs;
+    uint32_t tick = 0;
+    size_t i = 0;
+    while (i < bytes.size()) {
+        uint32_t value = 0;
+        int shift = 0;
+        while (i < bytes.size()) {
+            if (shift > 28) { // Longer than any u32 varint
+                throw std::runtime_error("fatal error: Corpus stream is corrupt");
+            }
+            uint8_t byte = bytes[i++];
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+
+        tick += value >> 3;
+        inputs.push_back(CorpusUtil::InputEvent{tick, static_cast<SimulationUtil::Input>(value & 7)});
+    }
+    return inputs;
+}
+
+std::vector<uint8_t> CorpusReader::decode_pieces(uint32_t game) const {
+    return decode_stream(CorpusUtil::COLUMN_PIECE_HEADS, game);
+}
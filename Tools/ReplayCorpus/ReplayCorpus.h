@@ -0,0 +1,161 @@
+#ifndef INC_3D_TETRIS_REPLAYCORPUS_H
+#define INC_3D_TETRIS_REPLAYCORPUS_H
+
+#include "Huffman.h"
+#include "Simulation.h"
+#include "Util/NonCopyable.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Corpus file layout
+ * ------------------
+ * Header, with the offset and size of every column
+ * Columns, each one contiguous and 8 byte aligned:
+ *     COLUMN_SEEDS         u32 per game
+ *     COLUMN_STATS         CorpusUtil::GameStats per game, fixed size so scans read it in place
+ *     COLUMN_INPUT_HEADS   u32 per game, the last input chunk of the game
+ *     COLUMN_INPUT_CHUNKS  CorpusUtil::Chunk per distinct input chunk
+ *     COLUMN_INPUT_DATA    CorpusUtil::StreamHeader, then the Huffman coded input events
+ *     COLUMN_PIECE_HEADS   \
+ *     COLUMN_PIECE_CHUNKS   > The same again for the sequence of spawned tetromino types
+ *     COLUMN_PIECE_DATA    /
+ *
+ * Input events are (tick delta << 3 | input) varints, ticks counted from the start of the game.
+ * Streams are cut into chunks, and a chunk is identified by its parent chunk and its contents,
+ * so games which start the same way, such as two games from the same seed, share their
+ * common prefix and only store where they differ.
+ */
+namespace CorpusUtil {
+    static constexpr char MAGIC[4] = {'T', '3', 'D', 'C'};
+    static constexpr uint32_t VERSION = 1;
+
+    static constexpr uint32_t NO_CHUNK = 0xFFFFFFFF;
+    static constexpr uint32_t CHUNK_SYMBOLS = 64; // Bytes per chunk before coding
+
+    enum Column : uint32_t {
+        COLUMN_SEEDS = 0,
+        COLUMN_STATS,
+        COLUMN_INPUT_HEADS,
+        COLUMN_INPUT_CHUNKS,
+        COLUMN_INPUT_DATA,
+        COLUMN_PIECE_HEADS,
+        COLUMN_PIECE_CHUNKS,
+        COLUMN_PIECE_DATA,
+        NUM_COLUMNS,
+    };
+
+    struct ColumnEntry {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct Header {
+        char     magic[4];
+        uint32_t version;
+        uint32_t num_games;
+        uint32_t padding;
+        ColumnEntry columns[NUM_COLUMNS];
+    };
+
+    struct GameStats {
+        uint32_t num_ticks;
+        uint32_t score;
+        uint32_t lines_cleared;
+        uint32_t num_pieces;
+        uint32_t num_inputs;
+        uint8_t  game_over; // Zero if the recording stopped before the game ended
+        uint8_t  padding[3];
+    };
+
+    struct Chunk {
+        uint32_t parent;     // NO_CHUNK for the first chunk of a stream
+        uint32_t raw_size;   // Bytes before coding
+        uint64_t bit_offset; // Into the coded data
+    };
+
+    struct StreamHeader {
+        uint64_t num_bits;
+        uint8_t  code_lengths[Huffman::NUM_SYMBOLS];
+    };
+
+    struct InputEvent {
+        uint32_t tick;
+        SimulationUtil::Input input;
+    };
+}
+
+// Builds a corpus in memory and writes it out column by column
+class CorpusWriter : public Util::NonCopyable {
+public:
+    void add_game(uint32_t seed, const CorpusUtil::GameStats& stats,
+                  const std::vector<CorpusUtil::InputEvent>& inputs,
+                  const std::vector<uint8_t>& pieces);
+
+    // Entropy codes the streams and writes the file
+    void write(const std::string& path);
+
+    // Getters
+    size_t get_num_games() const { return seeds.size(); }
+    size_t get_num_input_chunks() const { return input_stream.chunks.size(); }
+    size_t get_num_shared_chunks() const { return input_stream.shared + piece_stream.shared; }
+private:
+    // Deduplicated chunks of one kind of stream, kept uncoded until the file is written
+    struct Stream {
+        uint32_t add(const std::vector<uint8_t>& bytes); // Returns the head chunk
+
+        std::vector<uint32_t> heads;
+        std::vector<CorpusUtil::Chunk> chunks;
+        std::vector<std::vector<uint8_t>> chunk_bytes;
+        std::unordered_map<uint64_t, std::vector<uint32_t>> lookup; // Hash of parent and contents
+        size_t shared = 0; // Chunks which were found already stored
+    };
+
+    std::vector<uint32_t> seeds;
+    std::vector<CorpusUtil::GameStats> stats;
+    Stream input_stream;
+    Stream piece_stream;
+};
+
+// Reads a corpus through a memory mapping
+// The seed and stats columns are plain arrays, so scanning them decodes nothing
+class CorpusReader : public Util::NonCopyable {
+public:
+    explicit CorpusReader(const std::string& path);
+    ~CorpusReader();
+
+    // Returns every game for which the predicate holds, reading only the stats column
+    template <typename Predicate>
+    std::vector<uint32_t> find_games(Predicate predicate) const {
+        std::vector<uint32_t> found;
+        for (uint32_t i = 0; i < header.num_games; ++i) {
+            if (predicate(stats[i])) {
+                found.push_back(i);
+            }
+        }
+        return found;
+    }
+
+    std::vector<CorpusUtil::InputEvent> decode_inputs(uint32_t game) const;
+    std::vector<uint8_t> decode_pieces(uint32_t game) const;
+
+    // Getters
+    uint32_t get_num_games() const { return header.num_games; }
+    uint32_t get_seed(uint32_t game) const { return seeds[game]; }
+    const CorpusUtil::GameStats& get_stats(uint32_t game) const { return stats[game]; }
+private:
+    std::vector<uint8_t> decode_stream(CorpusUtil::Column heads_column, uint32_t game) const;
+
+    const uint8_t* data;
+    size_t size;
+
+    CorpusUtil::Header header;
+    const uint32_t* seeds;
+    const CorpusUtil::GameStats* stats;
+};
+
+
+#endif //INC_3D_TETRIS_REPLAYCORPUS_H
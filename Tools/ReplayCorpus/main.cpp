@@ -0,0 +1,200 @@
+// Builds and queries replay corpora
+//
+// replay-corpus build <corpus> <replay>...
+// replay-corpus query <corpus> [--min-lines n] [--min-score n] [--game-over]
+// replay-corpus extract <corpus> <game> <replay>
+
+#include "ReplayCorpus.h"
+#include "Replay.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    // A game as it is read out of a replay
+    struct PendingGame {
+        bool active = false;
+        uint32_t seed = 0;
+        uint32_t start_tick = 0;
+        CorpusUtil::GameStats stats;
+        std::vector<CorpusUtil::InputEvent> inputs;
+        std::vector<uint8_t> pieces;
+    };
+
+    void finish_game(CorpusWriter& writer, PendingGame& game, const Simulation& simulation) {
+        if (!game.active) {
+            return;
+        }
+        game.stats.score = simulation.get_score();
+        game.stats.lines_cleared = simulation.get_lines_cleared();
+        game.stats.num_pieces = static_cast<uint32_t>(game.pieces.size());
+        game.stats.num_inputs = static_cast<uint32_t>(game.inputs.size());
+        game.stats.game_over = simulation.is_game_over();
+        writer.add_game(game.seed, game.stats, game.inputs, game.pieces);
+        game.active = false;
+    }
+
+    // A corpus only stores seeds, so a game can only be added if it started from a fresh reset
+    bool starts_from_seed(const SimulationUtil::State& state) {
+        static Simulation fresh;
+        fresh.reset(state.seed);
+        SimulationUtil::State expected = fresh.save_state();
+        return std::memcmp(&expected, &state, sizeof(state)) == 0;
+    }
+
+    // Splits a replay into the games it holds, a reset shows up as a keyframe with a new seed
+    void add_replay(CorpusWriter& writer, const std::string& path) {
+        ReplayReader reader(path);
+        Simulation simulation;
+        PendingGame game;
+
+        ReplayUtil::TickRecord record;
+        while (reader.read_tick(record)) {
+            if (record.has_keyframe && (!game.active || record.keyframe.seed != game.seed)) {
+                finish_game(writer, game, simulation);
+
+                if (starts_from_seed(record.keyframe)) {
+                    game.active = true;
+                    game.seed = record.keyframe.seed;
+                    game.start_tick = record.tick;
+                    std::memset(&game.stats, 0, sizeof(game.stats));
+                    game.inputs.clear();
+                    game.pieces.clear();
+                    game.pieces.push_back(record.keyframe.current.type);
+                } else {
+                    std::cerr << path << ": skipping game at tick " << record.tick << " which did not start from a seed\n";
+                }
+            }
+            if (record.has_keyframe) {
+                simulation.load_state(record.keyframe);
+            }
+
+            simulation.tick(record.inputs, record.num_inputs);
+            if (!game.active) {
+                continue;
+            }
+
+            for (uint8_t i = 0; i < record.num_inputs; ++i) {
+                game.inputs.push_back(CorpusUtil::InputEvent{record.tick - game.start_tick, record.inputs[i]});
+            }
+            if (simulation.consume_events() & SimulationUtil::EVENT_SPAWNED) {
+                game.pieces.push_back(static_cast<uint8_t>(simulation.get_current_tetromino().get_type()));
+            }
+            game.stats.num_ticks = record.tick - game.start_tick + 1;
+        }
+        finish_game(writer, game, simulation);
+    }
+
+    int build(const std::string& corpus_path, const std::vector<std::string>& replay_paths) {
+        CorpusWriter writer;
+        for (auto& path : replay_paths) {
+            add_replay(writer, path);
+        }
+        writer.write(corpus_path);
+
+        std::cout << writer.get_num_games() << " games, " << writer.get_num_input_chunks() << " input chunks, "
+                  << writer.get_num_shared_chunks() << " chunks shared with earlier games\n";
+        return 0;
+    }
+
+    int query(const std::string& corpus_path, uint32_t min_lines, uint32_t min_score, bool only_game_over) {
+        CorpusReader reader(corpus_path);
+        auto games = reader.find_games([=](const CorpusUtil::GameStats& stats) {
+            return stats.lines_cleared >= min_lines && stats.score >= min_score &&
+                   (!only_game_over || stats.game_over);
+        });
+
+        for (uint32_t game : games) {
+            const CorpusUtil::GameStats& stats = reader.get_stats(game);
+            std::cout << game << "\tseed " << reader.get_seed(game) << "\tlines " << stats.lines_cleared
+                      << "\tscore " << stats.score << "\tticks " << stats.num_ticks
+                      << "\tpieces " << stats.num_pieces << "\n";
+        }
+        std::cout << games.size() << " of " << reader.get_num_games() << " games matched\n";
+        return 0;
+    }
+
+    // Resimulates a game from its seed and inputs, writing it back out as a replay
+    int extract(const std::string& corpus_path, uint32_t game, const std::string& replay_path) {
+        CorpusReader reader(corpus_path);
+        if (game >= reader.get_num_games()) {
+            std::cerr << "No game " << game << " in corpus\n";
+            return 1;
+        }
+        std::vector<CorpusUtil::InputEvent> inputs = reader.decode_inputs(game);
+
+        Simulation simulation;
+        simulation.reset(reader.get_seed(game));
+        ReplayWriter writer(replay_path, REPLAY_KEYFRAME_INTERVAL);
+
+        size_t next_input = 0;
+        for (uint32_t tick = 0; tick < reader.get_stats(game).num_ticks; ++tick) {
+            std::vector<SimulationUtil::Input> tick_inputs;
+            while (next_input < inputs.size() && inputs[next_input].tick == tick) {
+                tick_inputs.push_back(inputs[next_input++].input);
+            }
+
+            writer.begin_tick(simulation);
+            for (auto input : tick_inputs) {
+                writer.record_input(input);
+            }
+            simulation.tick(tick_inputs.data(), tick_inputs.size());
+            writer.end_tick();
+        }
+
+        if (simulation.get_score() != reader.get_stats(game).score) {
+            std::cerr << "Resimulated score " << simulation.get_score() << " does not match the recorded score "
+                      << reader.get_stats(game).score << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    void print_usage() {
+        std::cerr << "Usage:\n"
+                  << "  replay-corpus build <corpus> <replay>...\n"
+                  << "  replay-corpus query <corpus> [--min-lines n] [--min-score n] [--game-over]\n"
+                  << "  replay-corpus extract <corpus> <game> <replay>\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        print_usage();
+        return 1;
+    }
+    std::string command = argv[1];
+    std::string corpus_path = argv[2];
+
+    try {
+        if (command == "build" && argc >= 4) {
+            return build(corpus_path, std::vector<std::string>(argv + 3, argv + argc));
+        } else if (command == "query") {
+            uint32_t min_lines = 0, min_score = 0;
+            bool only_game_over = false;
+            for (int i = 3; i < argc; ++i) {
+                std::string arg = argv[i];
+                if (arg == "--min-lines" && i + 1 < argc) {
+                    min_lines = static_cast<uint32_t>(std::atoi(argv[++i]));
+                } else if (arg == "--min-score" && i + 1 < argc) {
+                    min_score = static_cast<uint32_t>(std::atoi(argv[++i]));
+                } else if (arg == "--game-over") {
+                    only_game_over = true;
+                }
+            }
+            return query(corpus_path, min_lines, min_score, only_game_over);
+        } else if (command == "extract" && argc == 5) {
+            return extract(corpus_path, static_cast<uint32_t>(std::atoi(argv[3])), argv[4]);
+        }
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    print_usage();
+    return 1;
+}